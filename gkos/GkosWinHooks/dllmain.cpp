@@ -29,6 +29,11 @@ __declspec(dllexport) bool IsGkosKeyboardKeyPressed (unsigned gkosKeyNum) {
     return gs_gkosKeyboardKeyState & (1 << gkosKeyNum);
 }
 
+// All keys at once: bit gkosKeyNum set for each pressed key
+__declspec(dllexport) unsigned GetGkosKeyboardKeyState () {
+    return gs_gkosKeyboardKeyState;
+}
+
 }
 
 //============================================================================
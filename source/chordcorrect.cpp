@@ -0,0 +1,357 @@
+#include "chordcorrect.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+namespace ChordCorrect {
+
+// Symbols: 0 is a word boundary, 1..26 are 'a'..'z'
+static const unsigned s_symbolCount        = 27;
+static const unsigned s_chordCount         = 64;
+static const unsigned s_beamWidth          = 16;
+static const unsigned s_maxCandidates      = 1 + 6 + 15; // Same chord, 1 key off, 2 keys off
+static const float    s_keyFlipCost        = 6.0f; // -ln(p) of one key being wrong
+static const float    s_uncertainFlipCost  = 2.5f; // ... when that key was still settling
+
+struct Candidate {
+    BYTE symbol;
+    BYTE diffKeys; // Key flags that differ from the observed chord
+};
+
+struct Hypothesis {
+    float cost;
+    BYTE  context[2];          // Previous two symbols, oldest first
+    BYTE  history[s_maxLag];   // Letters still open to rewriting, oldest first
+};
+
+// Chord -> symbol map and per-chord confusion candidates
+static BYTE      s_chordSymbol[s_chordCount]; // 0 if the chord isn't a single letter
+static BYTE      s_chordLetters[s_chordCount][s_maxChordLetters + 1]; // Multi-letter chords, 0-terminated
+static Candidate s_candidates[s_chordCount][s_maxCandidates];
+static unsigned  s_candidateCount[s_chordCount];
+
+// Language model: -ln P(c | a, b), indexed [a][b][c]
+static float     s_trigramCost[s_symbolCount][s_symbolCount][s_symbolCount];
+static bool      s_modelLoaded = false;
+
+// Decoder state
+static Hypothesis s_beam[s_beamWidth];
+static unsigned   s_beamCount    = 0;
+static unsigned   s_historyCount = 0; // Letters in every hypothesis' history
+static BYTE       s_typed[s_maxLag];  // What's actually on screen for those letters
+
+//=============================================================================
+static unsigned CountBits (unsigned value) {
+    unsigned count = 0;
+    for (; value; value &= value - 1)
+        ++count;
+    return count;
+}
+
+//=============================================================================
+struct CostLess {
+    bool operator() (const Hypothesis & lhs, const Hypothesis & rhs) const {
+        return lhs.cost < rhs.cost;
+    }
+};
+
+//=============================================================================
+static TCHAR SymbolToChar (BYTE symbol) {
+    return TCHAR(L'a' + symbol - 1);
+}
+
+//=============================================================================
+static const Hypothesis & GetBestHypothesis () {
+    unsigned best = 0;
+    for (unsigned i = 1; i < s_beamCount; ++i) {
+        if (s_beam[i].cost < s_beam[best].cost)
+            best = i;
+    }
+    return s_beam[best];
+}
+
+//=============================================================================
+static void ResetBeam (BYTE prevSymbol) {
+    memset(s_beam, 0, sizeof(s_beam));
+    s_beam[0].context[0] = prevSymbol;
+    s_beam[0].context[1] = 0;
+    s_beamCount          = 1;
+    s_historyCount       = 0;
+}
+
+//=============================================================================
+// Diff the best hypothesis against what's on screen and build the fix-up.
+static void BuildEdit (unsigned typedCount, Edit * edit) {
+
+    const Hypothesis & best = GetBestHypothesis();
+
+    unsigned first = 0;
+    while (first < typedCount && s_typed[first] == best.history[first])
+        ++first;
+
+    edit->backspaceCount = typedCount - first;
+    edit->charCount      = 0;
+    for (unsigned i = first; i < s_historyCount; ++i)
+        edit->chars[edit->charCount++] = SymbolToChar(best.history[i]);
+    edit->chars[edit->charCount] = 0;
+
+    memcpy(s_typed, best.history, s_historyCount);
+
+}
+
+//=============================================================================
+void Init (const GkosChord * layout) {
+
+    memset(s_chordSymbol, 0, sizeof(s_chordSymbol));
+    memset(s_chordLetters, 0, sizeof(s_chordLetters));
+    for (unsigned chord = 1; chord < s_chordCount; ++chord) {
+        const TCHAR * str = layout[chord].str;
+        if (!str)
+            continue;
+
+        unsigned length = 0;
+        while (str[length] >= L'a' && str[length] <= L'z' && length <= s_maxChordLetters)
+            ++length;
+        if (str[length] || !length || length > s_maxChordLetters)
+            continue; // Not all letters; a word boundary
+        if (length == 1) {
+            s_chordSymbol[chord] = BYTE(str[0] - L'a' + 1);
+            continue;
+        }
+        for (unsigned i = 0; i < length; ++i)
+            s_chordLetters[chord][i] = BYTE(str[i] - L'a' + 1);
+    }
+
+    // Every letter chord within two keys of the observed one is a candidate
+    for (unsigned observed = 1; observed < s_chordCount; ++observed) {
+        s_candidateCount[observed] = 0;
+        for (unsigned intended = 1; intended < s_chordCount; ++intended) {
+            const unsigned diffKeys = observed ^ intended;
+            if (!s_chordSymbol[intended] || CountBits(diffKeys) > 2)
+                continue;
+            Candidate & candidate = s_candidates[observed][s_candidateCount[observed]++];
+            candidate.symbol   = s_chordSymbol[intended];
+            candidate.diffKeys = BYTE(diffKeys);
+        }
+    }
+
+    ResetBeam(0);
+
+}
+
+//=============================================================================
+bool LoadLanguageModel (const TCHAR * corpusPath) {
+
+    s_modelLoaded = false;
+
+    FILE * file = NULL;
+    if (_wfopen_s(&file, corpusPath, L"rb") != 0 || !file)
+        return false;
+
+    static unsigned s_trigramCounts[s_symbolCount][s_symbolCount][s_symbolCount];
+    static unsigned s_bigramCounts[s_symbolCount][s_symbolCount];
+    static unsigned s_unigramCounts[s_symbolCount];
+    memset(s_trigramCounts, 0, sizeof(s_trigramCounts));
+    memset(s_bigramCounts, 0, sizeof(s_bigramCounts));
+    memset(s_unigramCounts, 0, sizeof(s_unigramCounts));
+
+    // Fold the corpus down to letters and word boundaries
+    BYTE     a = 0, b = 0;
+    unsigned total = 0;
+    char     readBuf[4096];
+    size_t   readCount;
+    while ((readCount = fread(readBuf, 1, sizeof(readBuf), file)) > 0) {
+        for (size_t i = 0; i < readCount; ++i) {
+            char ch = readBuf[i];
+            if (ch >= 'A' && ch <= 'Z')
+                ch = char(ch - 'A' + 'a');
+            const BYTE c = (ch >= 'a' && ch <= 'z') ? BYTE(ch - 'a' + 1) : 0;
+            if (!c && !b)
+                continue; // Collapse runs of boundaries
+
+            ++s_trigramCounts[a][b][c];
+            ++s_bigramCounts[b][c];
+            ++s_unigramCounts[c];
+            ++total;
+            a = b;
+            b = c;
+        }
+    }
+    fclose(file);
+
+    if (!total)
+        return false;
+
+    // Interpolated trigram/bigram/unigram, add-one on the unigram so nothing is impossible
+    for (unsigned i = 0; i < s_symbolCount; ++i) {
+        for (unsigned j = 0; j < s_symbolCount; ++j) {
+            unsigned triTotal = 0, biTotal = 0;
+            for (unsigned k = 0; k < s_symbolCount; ++k) {
+                triTotal += s_trigramCounts[i][j][k];
+                biTotal  += s_bigramCounts[j][k];
+            }
+            for (unsigned k = 0; k < s_symbolCount; ++k) {
+                const float tri = triTotal ? float(s_trigramCounts[i][j][k]) / triTotal : 0.0f;
+                const float bi  = biTotal  ? float(s_bigramCounts[j][k]) / biTotal : 0.0f;
+                const float uni = float(s_unigramCounts[k] + 1) / (total + s_symbolCount);
+                s_trigramCost[i][j][k] = -logf(0.6f * tri + 0.3f * bi + 0.1f * uni);
+            }
+        }
+    }
+
+    s_modelLoaded = true;
+    return true;
+
+}
+
+//=============================================================================
+bool IsReady () {
+    return s_modelLoaded;
+}
+
+//=============================================================================
+bool IsLetterChord (unsigned chordCode) {
+    return chordCode < s_chordCount && (s_chordSymbol[chordCode] != 0 || s_chordLetters[chordCode][0] != 0);
+}
+
+//=============================================================================
+// Apply a later edit on top of an earlier one, as if both had been sent
+static void AppendEdit (const Edit & later, Edit * edit) {
+    const unsigned eraseCount = std::min(later.backspaceCount, edit->charCount);
+    edit->charCount      -= eraseCount;
+    edit->backspaceCount += later.backspaceCount - eraseCount;
+    memcpy(edit->chars + edit->charCount, later.chars, later.charCount * sizeof(later.chars[0]));
+    edit->charCount += later.charCount;
+    edit->chars[edit->charCount] = 0;
+}
+
+//=============================================================================
+// Add one letter to every hypothesis, trying each candidate for it
+static void AppendLetter (
+    const Candidate * candidates,
+    unsigned          candidateCount,
+    unsigned          uncertainKeys,
+    Edit *            edit
+) {
+
+    // The oldest letter falls out of the window: lock in the best guess for it
+    // and drop every hypothesis that disagrees.
+    if (s_historyCount == s_maxLag) {
+        const BYTE frozen = GetBestHypothesis().history[0];
+        unsigned   kept   = 0;
+        for (unsigned i = 0; i < s_beamCount; ++i) {
+            if (s_beam[i].history[0] != frozen)
+                continue;
+            Hypothesis & hyp = s_beam[kept++];
+            hyp = s_beam[i];
+            memmove(hyp.history, hyp.history + 1, s_maxLag - 1);
+        }
+        s_beamCount = kept;
+        memmove(s_typed, s_typed + 1, s_maxLag - 1);
+        --s_historyCount;
+    }
+
+    // Extend every hypothesis with every candidate for the observed chord
+    static Hypothesis s_next[s_beamWidth * s_maxCandidates];
+    static short      s_stateSlot[s_symbolCount][s_symbolCount];
+    unsigned          nextCount = 0;
+    memset(s_stateSlot, -1, sizeof(s_stateSlot));
+
+    for (unsigned i = 0; i < s_beamCount; ++i) {
+        const Hypothesis & hyp = s_beam[i];
+        for (unsigned j = 0; j < candidateCount; ++j) {
+            const Candidate & candidate = candidates[j];
+            const unsigned    sureKeys  = candidate.diffKeys & ~uncertainKeys;
+            const unsigned    looseKeys = candidate.diffKeys & uncertainKeys;
+            const float       cost      =
+                hyp.cost +
+                CountBits(sureKeys) * s_keyFlipCost +
+                CountBits(looseKeys) * s_uncertainFlipCost +
+                s_trigramCost[hyp.context[0]][hyp.context[1]][candidate.symbol];
+
+            // Hypotheses ending in the same two symbols have the same future;
+            // only the cheaper one can win.
+            short & slot = s_stateSlot[hyp.context[1]][candidate.symbol];
+            if (slot >= 0 && s_next[slot].cost <= cost)
+                continue;
+            if (slot < 0)
+                slot = short(nextCount++);
+
+            Hypothesis & next = s_next[slot];
+            next.cost       = cost;
+            next.context[0] = hyp.context[1];
+            next.context[1] = candidate.symbol;
+            memcpy(next.history, hyp.history, s_historyCount);
+            next.history[s_historyCount] = candidate.symbol;
+        }
+    }
+
+    // Keep the cheapest, rebased so costs don't grow without bound
+    s_beamCount = std::min(nextCount, s_beamWidth);
+    std::partial_sort(s_next, s_next + s_beamCount, s_next + nextCount, CostLess());
+    const float baseCost = s_next[0].cost;
+    for (unsigned i = 0; i < s_beamCount; ++i) {
+        s_beam[i]       = s_next[i];
+        s_beam[i].cost -= baseCost;
+    }
+
+    const unsigned typedCount = s_historyCount++;
+    BuildEdit(typedCount, edit);
+
+}
+
+//=============================================================================
+void CommitLetter (unsigned chordCode, unsigned uncertainKeys, Edit * edit) {
+
+    assert(IsLetterChord(chordCode));
+
+    if (s_chordSymbol[chordCode]) {
+        AppendLetter(s_candidates[chordCode], s_candidateCount[chordCode], uncertainKeys, edit);
+        return;
+    }
+
+    // Each letter of a multi-letter chord is certain, but still moves the
+    // window on and can change the best spelling of the letters before it
+    edit->backspaceCount = 0;
+    edit->charCount      = 0;
+    edit->chars[0]       = 0;
+    for (const BYTE * letter = s_chordLetters[chordCode]; *letter; ++letter) {
+        Candidate candidate;
+        candidate.symbol   = *letter;
+        candidate.diffKeys = 0;
+
+        Edit letterEdit;
+        AppendLetter(&candidate, 1, 0, &letterEdit);
+        AppendEdit(letterEdit, edit);
+    }
+
+}
+
+//=============================================================================
+void CommitBoundary (Edit * edit) {
+
+    edit->backspaceCount = 0;
+    edit->charCount      = 0;
+    edit->chars[0]       = 0;
+    if (!s_historyCount) {
+        ResetBeam(0);
+        return;
+    }
+
+    // Score how well each spelling ends a word, then settle on the best
+    for (unsigned i = 0; i < s_beamCount; ++i) {
+        Hypothesis & hyp = s_beam[i];
+        hyp.cost += s_trigramCost[hyp.context[0]][hyp.context[1]][0];
+    }
+    BuildEdit(s_historyCount, edit);
+
+    ResetBeam(GetBestHypothesis().context[1]);
+
+}
+
+//=============================================================================
+void Reset () {
+    ResetBeam(0);
+}
+
+} // namespace ChordCorrect
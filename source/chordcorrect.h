@@ -0,0 +1,49 @@
+#pragma once
+
+#include "misc.h"
+
+// Optional chord error correction.  A mis-timed finger usually turns the
+// intended chord into a neighbor one or two keys away (0x03 "o" vs 0x01 "a"),
+// so each committed letter chord is decoded against its neighbors with a
+// small character trigram model.  A bounded-lag beam search picks the most
+// likely spelling of the last few letters and reports how to fix up what was
+// already typed (backspace + retype).
+
+namespace ChordCorrect {
+
+static const unsigned s_maxLag          = 3; // Letters that may still be rewritten
+static const unsigned s_maxChordLetters = 2; // Letters one chord can type ("th", "wh")
+
+struct Edit {
+    unsigned backspaceCount;                      // Characters to erase before typing
+    unsigned charCount;
+    TCHAR    chars[s_maxLag + s_maxChordLetters]; // Characters to type afterwards
+};
+
+// Build the chord <-> letter maps from a layout table of 64 chords.
+void Init (const GkosChord * layout);
+
+// Train the trigram model from a plain text file.  Correction stays
+// unavailable (IsReady() false) until this succeeds.
+bool LoadLanguageModel (const TCHAR * corpusPath);
+bool IsReady ();
+
+// True for chords that type one letter, and for those that type a couple
+// ("th", "wh"), which stay part of the word.
+bool IsLetterChord (unsigned chordCode);
+
+// A letter chord was committed.  uncertainKeys are the gkos key flags that
+// were still settling while the chord was pressed; flipping those is cheaper.
+// The edit always types the new letters (possibly after rewriting others).
+// Multi-letter chords are taken as typed; only their context can change the
+// letters before them.
+void CommitLetter (unsigned chordCode, unsigned uncertainKeys, Edit * edit);
+
+// A word ended (space, punctuation, ...).  Gives the model a last chance to
+// fix the word before the boundary itself is typed by the caller.
+void CommitBoundary (Edit * edit);
+
+// The cursor moved or text was edited; forget what's on screen.
+void Reset ();
+
+} // namespace ChordCorrect
@@ -0,0 +1,484 @@
+#include "chordmacros.h"
+#include <stdio.h>
+#include <vector>
+
+namespace ChordMacros {
+
+static const unsigned s_chordCount     = 64;
+static const DWORD    s_fileMagic      = 'GKMC';
+static const DWORD    s_fileVersion    = 2;
+static const unsigned s_maxLineLength  = 1024;
+
+// Compiled file layout: header, transitions[stateCount][64],
+// stateMacro[stateCount], macros[macroCount], keys[keyCount]
+struct FileHeader {
+    DWORD    magic;
+    DWORD    version;
+    DWORD    stateCount;
+    DWORD    macroCount;
+    DWORD    keyCount;
+    FILETIME sourceTime; // Write time of the text it was compiled from
+};
+
+struct FileMacro {
+    DWORD eraseCount;
+    DWORD firstKey;
+    DWORD keyCount;
+};
+
+struct MacroTable {
+    HANDLE             file;
+    HANDLE             mapping;
+    const BYTE *       view;
+    const FileHeader * header;
+    const DWORD *      transitions;
+    const DWORD *      stateMacro; // Macro index + 1 completed on entering the state, 0 for none
+    const FileMacro *  macros;
+    const DWORD *      keys;
+};
+
+// Source form of one macro, before compiling
+struct MacroSource {
+    std::vector<BYTE>  trigger; // Chord codes
+    std::vector<DWORD> keys;
+};
+
+// Layout maps
+static BYTE  s_charChord[0x80];              // Chord that types an ASCII char, 0 if none
+static BYTE  s_chordCharCount[s_chordCount]; // Characters the chord puts on screen
+
+static MacroTable s_table;
+static DWORD      s_state = 0;
+
+//=============================================================================
+static int HexDigit (TCHAR ch) {
+    if (ch >= L'0' && ch <= L'9')
+        return ch - L'0';
+    if (ch >= L'a' && ch <= L'f')
+        return ch - L'a' + 10;
+    if (ch >= L'A' && ch <= L'F')
+        return ch - L'A' + 10;
+    return -1;
+}
+
+//=============================================================================
+static bool ParseTrigger (const TCHAR * str, MacroSource * macro) {
+
+    while (*str) {
+        if (str[0] == L'#' && HexDigit(str[1]) >= 0 && HexDigit(str[2]) >= 0) {
+            const unsigned chord = HexDigit(str[1]) * 16 + HexDigit(str[2]);
+            if (!chord || chord >= s_chordCount)
+                return false;
+            macro->trigger.push_back(BYTE(chord));
+            str += 3;
+            continue;
+        }
+
+        if (unsigned(*str) >= 0x80 || !s_charChord[*str])
+            return false; // No chord types this character
+        macro->trigger.push_back(s_charChord[*str]);
+        ++str;
+    }
+
+    return !macro->trigger.empty();
+
+}
+
+//=============================================================================
+static bool ParseExpansion (const TCHAR * str, MacroSource * macro) {
+
+    while (*str) {
+        if (*str != L'\\') {
+            macro->keys.push_back(DWORD(*str++));
+            continue;
+        }
+
+        ++str;
+        switch (*str) {
+            case L'n':  macro->keys.push_back(MACRO_KEY_VKEY | VK_RETURN); ++str; break;
+            case L't':  macro->keys.push_back(MACRO_KEY_VKEY | VK_TAB);    ++str; break;
+            case L'b':  macro->keys.push_back(MACRO_KEY_VKEY | VK_BACK);   ++str; break;
+            case L'\\': macro->keys.push_back(DWORD(L'\\'));               ++str; break;
+            case L'k': {
+                if (HexDigit(str[1]) < 0 || HexDigit(str[2]) < 0)
+                    return false;
+                macro->keys.push_back(MACRO_KEY_VKEY | (HexDigit(str[1]) * 16 + HexDigit(str[2])));
+                str += 3;
+            } break;
+            default:
+                return false;
+        }
+    }
+
+    return !macro->keys.empty();
+
+}
+
+//=============================================================================
+static bool ReadSource (const TCHAR * sourcePath, std::vector<MacroSource> * macros) {
+
+    FILE * file = NULL;
+    if (_wfopen_s(&file, sourcePath, L"rt, ccs=UTF-8") != 0 || !file)
+        return false;
+
+    TCHAR    line[s_maxLineLength];
+    unsigned lineNum = 0;
+    while (fgetws(line, s_maxLineLength, file)) {
+        ++lineNum;
+
+        size_t length = wcslen(line);
+        while (length && (line[length - 1] == L'\n' || line[length - 1] == L'\r'))
+            line[--length] = 0;
+        if (!length || line[0] == L';')
+            continue;
+
+        TCHAR * tab = wcschr(line, L'\t');
+        MacroSource macro;
+        if (tab) {
+            *tab = 0;
+            if (ParseTrigger(line, &macro) && ParseExpansion(tab + 1, &macro)) {
+                macros->push_back(macro);
+                continue;
+            }
+        }
+
+        TCHAR buf[64];
+        swprintf_s(buf, L"Skipping bad macro on line %u\n", lineNum);
+        OutputDebugString(buf);
+    }
+
+    fclose(file);
+    return true;
+
+}
+
+//=============================================================================
+static bool WriteCompiled (
+    const std::vector<MacroSource> & macros,
+    const FILETIME &                 sourceTime,
+    const TCHAR *                    compiledPath
+) {
+
+    // Trie of triggers, one full 64-way row per state
+    std::vector<DWORD> transitions(s_chordCount, 0);
+    std::vector<DWORD> stateMacro(1, 0);
+    for (size_t i = 0; i < macros.size(); ++i) {
+        const std::vector<BYTE> & trigger = macros[i].trigger;
+        DWORD state = 0;
+        for (size_t j = 0; j < trigger.size(); ++j) {
+            DWORD & next = transitions[state * s_chordCount + trigger[j]];
+            if (!next) {
+                next = DWORD(stateMacro.size());
+                stateMacro.push_back(0);
+                transitions.resize(transitions.size() + s_chordCount, 0);
+            }
+            state = transitions[state * s_chordCount + trigger[j]];
+        }
+        if (!stateMacro[state])
+            stateMacro[state] = DWORD(i + 1);
+    }
+
+    // Breadth-first, fill every missing edge from the failure state so the
+    // automaton never has to walk failure links at runtime.  A state also
+    // completes whatever its failure state completes (a shorter trigger that
+    // is a suffix of this one).
+    const DWORD        stateCount = DWORD(stateMacro.size());
+    std::vector<DWORD> failure(stateCount, 0);
+    std::vector<DWORD> queue;
+    queue.reserve(stateCount);
+    for (unsigned c = 0; c < s_chordCount; ++c) {
+        if (transitions[c])
+            queue.push_back(transitions[c]);
+    }
+    for (size_t head = 0; head < queue.size(); ++head) {
+        const DWORD state = queue[head];
+        if (!stateMacro[state])
+            stateMacro[state] = stateMacro[failure[state]];
+        for (unsigned c = 0; c < s_chordCount; ++c) {
+            DWORD &     next     = transitions[state * s_chordCount + c];
+            const DWORD fallback = transitions[failure[state] * s_chordCount + c];
+            if (next) {
+                failure[next] = fallback;
+                queue.push_back(next);
+            }
+            else
+                next = fallback;
+        }
+    }
+
+    std::vector<FileMacro> fileMacros(macros.size());
+    std::vector<DWORD>     keys;
+    for (size_t i = 0; i < macros.size(); ++i) {
+        const MacroSource & macro = macros[i];
+        FileMacro &         fileMacro = fileMacros[i];
+
+        // Every trigger chord but the last has already been typed by then
+        fileMacro.eraseCount = 0;
+        for (size_t j = 0; j + 1 < macro.trigger.size(); ++j)
+            fileMacro.eraseCount += s_chordCharCount[macro.trigger[j]];
+        fileMacro.firstKey = DWORD(keys.size());
+        fileMacro.keyCount = DWORD(macro.keys.size());
+        keys.insert(keys.end(), macro.keys.begin(), macro.keys.end());
+    }
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic      = s_fileMagic;
+    header.version    = s_fileVersion;
+    header.stateCount = stateCount;
+    header.macroCount = DWORD(fileMacros.size());
+    header.keyCount   = DWORD(keys.size());
+    header.sourceTime = sourceTime;
+
+    FILE * file = NULL;
+    if (_wfopen_s(&file, compiledPath, L"wb") != 0 || !file)
+        return false;
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    written = written && fwrite(&transitions[0], sizeof(DWORD), transitions.size(), file) == transitions.size();
+    written = written && fwrite(&stateMacro[0], sizeof(DWORD), stateMacro.size(), file) == stateMacro.size();
+    if (!fileMacros.empty())
+        written = written && fwrite(&fileMacros[0], sizeof(FileMacro), fileMacros.size(), file) == fileMacros.size();
+    if (!keys.empty())
+        written = written && fwrite(&keys[0], sizeof(DWORD), keys.size(), file) == keys.size();
+    fclose(file);
+
+    return written;
+
+}
+
+//=============================================================================
+static void UnmapTable (MacroTable * table) {
+    if (table->view)
+        UnmapViewOfFile(table->view);
+    if (table->mapping)
+        CloseHandle(table->mapping);
+    if (table->file && table->file != INVALID_HANDLE_VALUE)
+        CloseHandle(table->file);
+    memset(table, 0, sizeof(*table));
+}
+
+//=============================================================================
+static bool MapTable (const TCHAR * compiledPath, MacroTable * table) {
+
+    memset(table, 0, sizeof(*table));
+    table->file = CreateFile(compiledPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (table->file == INVALID_HANDLE_VALUE) {
+        table->file = NULL;
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(table->file, &fileSize) || fileSize.QuadPart < LONGLONG(sizeof(FileHeader))) {
+        UnmapTable(table);
+        return false;
+    }
+
+    table->mapping = CreateFileMapping(table->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (table->mapping)
+        table->view = (const BYTE *)MapViewOfFile(table->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!table->view) {
+        UnmapTable(table);
+        return false;
+    }
+
+    const FileHeader * header = (const FileHeader *)table->view;
+    const LONGLONG expectedSize =
+        LONGLONG(sizeof(FileHeader)) +
+        LONGLONG(header->stateCount) * (s_chordCount + 1) * sizeof(DWORD) +
+        LONGLONG(header->macroCount) * sizeof(FileMacro) +
+        LONGLONG(header->keyCount) * sizeof(DWORD);
+    if (header->magic != s_fileMagic || header->version != s_fileVersion || !header->stateCount || fileSize.QuadPart != expectedSize) {
+        UnmapTable(table);
+        return false;
+    }
+
+    table->header      = header;
+    table->transitions = (const DWORD *)(header + 1);
+    table->stateMacro  = table->transitions + header->stateCount * s_chordCount;
+    table->macros      = (const FileMacro *)(table->stateMacro + header->stateCount);
+    table->keys        = (const DWORD *)(table->macros + header->macroCount);
+
+    // A stale or hand-edited file can have the right size and still point
+    // anywhere.  Macros and state macros are cheap to check here; the
+    // transition table is too big, so CommitChord range-checks each step.
+    for (DWORD i = 0; i < header->macroCount; ++i) {
+        const FileMacro & macro = table->macros[i];
+        if (macro.firstKey > header->keyCount || macro.keyCount > header->keyCount - macro.firstKey) {
+            UnmapTable(table);
+            return false;
+        }
+    }
+    for (DWORD i = 0; i < header->stateCount; ++i) {
+        if (table->stateMacro[i] > header->macroCount) {
+            UnmapTable(table);
+            return false;
+        }
+    }
+    return true;
+
+}
+
+//=============================================================================
+static bool GetSourceTime (const TCHAR * sourcePath, FILETIME * sourceTime) {
+    HANDLE file = CreateFile(sourcePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    const BOOL gotTime = GetFileTime(file, NULL, NULL, sourceTime);
+    CloseHandle(file);
+    return gotTime != FALSE;
+}
+
+//=============================================================================
+void Init (const GkosChord * layout) {
+
+    memset(s_charChord, 0, sizeof(s_charChord));
+    memset(s_chordCharCount, 0, sizeof(s_chordCharCount));
+    for (unsigned chord = 1; chord < s_chordCount; ++chord) {
+        const GkosChord & key = layout[chord];
+
+        // Multi-letter chords ("th", "the ") type every letter, and all of
+        // them need erasing
+        if (key.str)
+            s_chordCharCount[chord] = BYTE(wcslen(key.str));
+        else if (key.vkey == VK_SPACE)
+            s_chordCharCount[chord] = 1;
+
+        TCHAR ch = 0;
+        if (key.str && key.str[0] && !key.str[1])
+            ch = key.str[0];
+        else if (key.vkey == VK_SPACE)
+            ch = L' ';
+        if (ch && unsigned(ch) < 0x80 && !s_charChord[ch])
+            s_charChord[ch] = BYTE(chord);
+    }
+
+}
+
+//=============================================================================
+bool Load (const TCHAR * sourcePath, const TCHAR * compiledPath) {
+
+    Unload();
+
+    // Reuse the compiled table only if it came from this exact source
+    FILETIME sourceTime;
+    const bool haveSource = GetSourceTime(sourcePath, &sourceTime);
+    if (MapTable(compiledPath, &s_table)) {
+        if (!haveSource || CompareFileTime(&s_table.header->sourceTime, &sourceTime) == 0)
+            return true;
+        UnmapTable(&s_table);
+    }
+    if (!haveSource)
+        return false;
+
+    std::vector<MacroSource> macros;
+    if (!ReadSource(sourcePath, &macros) || !WriteCompiled(macros, sourceTime, compiledPath))
+        return false;
+
+    return MapTable(compiledPath, &s_table);
+
+}
+
+//=============================================================================
+void Unload () {
+    UnmapTable(&s_table);
+    s_state = 0;
+}
+
+//=============================================================================
+bool IsLoaded () {
+    return s_table.header != NULL;
+}
+
+//=============================================================================
+bool CommitChord (unsigned chordCode, Expansion * expansion) {
+
+    assert(chordCode < s_chordCount);
+    if (!s_table.header)
+        return false;
+
+    s_state = s_table.transitions[s_state * s_chordCount + chordCode];
+    if (s_state >= s_table.header->stateCount) {
+        s_state = 0; // Corrupt table; MapTable can't afford to check every transition
+        return false;
+    }
+    const DWORD macroNum = s_table.stateMacro[s_state];
+    if (!macroNum)
+        return false;
+
+    const FileMacro & macro = s_table.macros[macroNum - 1];
+    expansion->eraseCount = macro.eraseCount;
+    expansion->keyCount   = macro.keyCount;
+    expansion->keys       = s_table.keys + macro.firstKey;
+    s_state = 0; // Don't let the expansion chain into another trigger
+    return true;
+
+}
+
+//=============================================================================
+void Reset () {
+    s_state = 0;
+}
+
+//=============================================================================
+bool RunBenchmark (unsigned macroCount, const TCHAR * compiledPath, BenchmarkResult * result) {
+
+    static const unsigned s_chordsPerRun = 10 * 1000 * 1000;
+
+    // Random 2-8 chord triggers with short expansions
+    std::vector<MacroSource> macros(macroCount);
+    unsigned seed = 12345;
+    for (unsigned i = 0; i < macroCount; ++i) {
+        seed = seed * 1103515245 + 12345;
+        const unsigned length = 2 + (seed >> 16) % 7;
+        for (unsigned j = 0; j < length; ++j) {
+            seed = seed * 1103515245 + 12345;
+            macros[i].trigger.push_back(BYTE(1 + (seed >> 16) % (s_chordCount - 1)));
+        }
+        macros[i].keys.push_back(L'x');
+    }
+
+    LARGE_INTEGER frequency, compileStart, mapStart, runStart, runEnd;
+    QueryPerformanceFrequency(&frequency);
+
+    QueryPerformanceCounter(&compileStart);
+    FILETIME noTime = {0, 0};
+    if (!WriteCompiled(macros, noTime, compiledPath))
+        return false;
+
+    QueryPerformanceCounter(&mapStart);
+    MacroTable table;
+    if (!MapTable(compiledPath, &table))
+        return false;
+
+    QueryPerformanceCounter(&runStart);
+    DWORD    state   = 0;
+    unsigned matches = 0;
+    for (unsigned i = 0; i < s_chordsPerRun; ++i) {
+        seed  = seed * 1103515245 + 12345;
+        state = table.transitions[state * s_chordCount + 1 + (seed >> 16) % (s_chordCount - 1)];
+        if (table.stateMacro[state]) {
+            ++matches;
+            state = 0;
+        }
+    }
+    QueryPerformanceCounter(&runEnd);
+
+    const double msPerTick = 1000.0 / double(frequency.QuadPart);
+    result->stateCount = table.header->stateCount;
+    result->fileBytes  =
+        sizeof(FileHeader) +
+        ULONGLONG(table.header->stateCount) * (s_chordCount + 1) * sizeof(DWORD) +
+        ULONGLONG(table.header->macroCount) * sizeof(FileMacro) +
+        ULONGLONG(table.header->keyCount) * sizeof(DWORD);
+    result->compileMs  = (mapStart.QuadPart - compileStart.QuadPart) * msPerTick;
+    result->mapUs      = (runStart.QuadPart - mapStart.QuadPart) * msPerTick * 1000.0;
+    result->chordCount = s_chordsPerRun;
+    result->matchMs    = (runEnd.QuadPart - runStart.QuadPart) * msPerTick;
+    result->matchCount = matches;
+
+    UnmapTable(&table);
+    return true;
+
+}
+
+} // namespace ChordMacros
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "misc.h"
+
+// User-defined macros.  Each line of the macro file binds a trigger to an
+// expansion, separated by a tab:
+//
+//     btw<TAB>by the way
+//     #2F#2F<TAB>\k1B:wq\n
+//
+// Triggers are typed text (mapped back to the chords that produce it) and/or
+// raw chords written as '#' plus two hex digits.  Expansions are text, with
+// \n (Enter), \t (Tab), \b (Backspace), \\ and \kHH (any virtual key).  Lines
+// starting with ';' are comments.  Triggers match anywhere in the chord
+// stream, so start one with a space if it should only fire at a word start.
+// When triggers overlap, the first one to complete wins.
+//
+// The triggers are compiled into an Aho-Corasick automaton over chord codes,
+// flattened into a full 64-way transition table and written next to the
+// source file, so startup just maps it and each committed chord is a single
+// table lookup.
+
+namespace ChordMacros {
+
+static const DWORD MACRO_KEY_VKEY = 1 << 16; // Set on keys that are virtual keys, not characters
+
+struct Expansion {
+    unsigned      eraseCount; // Trigger characters already typed that need erasing
+    unsigned      keyCount;
+    const DWORD * keys;       // UTF-16 characters, or MACRO_KEY_VKEY | vkey
+};
+
+// Build the text <-> chord maps from a layout table of 64 chords.
+void Init (const GkosChord * layout);
+
+// Map the compiled macros, recompiling them first if the source file changed.
+bool Load (const TCHAR * sourcePath, const TCHAR * compiledPath);
+void Unload ();
+bool IsLoaded ();
+
+// Feed a committed chord.  Returns true (and the expansion) if it completed a
+// trigger; the chord itself should then not be typed.
+bool CommitChord (unsigned chordCode, Expansion * expansion);
+
+// The cursor moved or text was edited; start matching afresh.  A chord no
+// trigger uses already does this by itself, so this is for changes the
+// chord stream can't show, like the pointer moving or a click.
+void Reset ();
+
+struct BenchmarkResult {
+    unsigned  stateCount;
+    ULONGLONG fileBytes;
+    double    compileMs;
+    double    mapUs;
+    unsigned  chordCount;
+    double    matchMs;
+    unsigned  matchCount;
+};
+
+// Compile macroCount random triggers to compiledPath, map the table and
+// match a stream of random chords through it.  Used by gkosmacros; the
+// compiled file is left for the caller to delete.
+bool RunBenchmark (unsigned macroCount, const TCHAR * compiledPath, BenchmarkResult * result);
+
+} // namespace ChordMacros
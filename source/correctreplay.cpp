@@ -0,0 +1,271 @@
+// gkoscorrect: replays a chord session through ChordCorrect.
+//
+// A session file lists committed chords in order as hex pairs, "chord
+// uncertain", where uncertain holds the gkos key flags that were still
+// settling when the chord was pressed (what Ds4Input::GetUncertainKeys
+// reports).  Pairs are separated by whitespace; ';' starts a comment.  The
+// app writes this format when session recording is on.
+//
+// Every chord is handled the way ReadDs4RawInput handles it, once as typed
+// and once with correction, and both results are scored against the text
+// the user meant to type.  Accuracy is 1 - edit distance / expected length.
+// The run fails if correction makes the text worse than it was typed, if
+// corrected accuracy is under the given minimum, or if any decode goes over
+// budget.
+//
+// Usage: gkoscorrect <corpus.txt> <session.txt> <expected.txt> [min accuracy %]
+//
+// The samples next to the project reproduce the checked numbers (typed
+// 92.45%, corrected 95.88%):
+//
+//     gkoscorrect sample_corpus.txt sample_session.txt sample_expected.txt 95
+
+#include "chordcorrect.h"
+#include "layouts.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static const unsigned s_timingRunCount = 5;    // Keep each commit's fastest run, so preemption doesn't count
+static const double   s_decodeBudgetUs = 50.0; // Per committed chord
+
+struct SessionChord {
+    BYTE chordCode;
+    BYTE uncertainKeys;
+};
+
+struct DecodeStats {
+    unsigned               letterCount;
+    unsigned               editCount;   // Commits that rewrote already typed letters
+    std::vector<ULONGLONG> commitTicks; // Per decoded commit, fastest over all runs
+};
+
+//=============================================================================
+static bool ReadSession (const TCHAR * path, std::vector<SessionChord> * session) {
+
+    FILE * file = NULL;
+    if (_wfopen_s(&file, path, L"r") != 0 || !file)
+        return false;
+
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        char * comment = strchr(line, ';');
+        if (comment)
+            *comment = 0;
+
+        const char * pos = line;
+        unsigned     chordCode, uncertainKeys;
+        int          used;
+        while (sscanf_s(pos, "%x %x%n", &chordCode, &uncertainKeys, &used) == 2) {
+            SessionChord chord;
+            chord.chordCode     = BYTE(chordCode % GKOS_CHORD_COUNT);
+            chord.uncertainKeys = BYTE(uncertainKeys % GKOS_CHORD_COUNT);
+            session->push_back(chord);
+            pos += used;
+        }
+    }
+    fclose(file);
+
+    return !session->empty();
+
+}
+
+//=============================================================================
+static bool ReadText (const TCHAR * path, std::wstring * text) {
+
+    FILE * file = NULL;
+    if (_wfopen_s(&file, path, L"rb") != 0 || !file)
+        return false;
+
+    char   readBuf[4096];
+    size_t readCount;
+    while ((readCount = fread(readBuf, 1, sizeof(readBuf), file)) > 0) {
+        for (size_t i = 0; i < readCount; ++i) {
+            if (readBuf[i] != '\r')
+                text->push_back(TCHAR(BYTE(readBuf[i])));
+        }
+    }
+    fclose(file);
+
+    return true;
+
+}
+
+//=============================================================================
+// What the app types for a chord it doesn't correct
+static void TypeChord (const GkosChord & gkosKey, std::wstring * text) {
+
+    switch (gkosKey.vkey) {
+        case VK_BACK:   if (!text->empty()) text->erase(text->size() - 1); return;
+        case VK_SPACE:  text->push_back(L' ');  return;
+        case VK_RETURN: text->push_back(L'\n'); return;
+        case VK_TAB:    text->push_back(L'\t'); return;
+    }
+    if (!gkosKey.vkey && gkosKey.str)
+        text->append(gkosKey.str);
+
+}
+
+//=============================================================================
+static void ApplyEdit (const ChordCorrect::Edit & edit, std::wstring * text) {
+    const size_t eraseCount = std::min<size_t>(edit.backspaceCount, text->size());
+    text->erase(text->size() - eraseCount);
+    text->append(edit.chars, edit.charCount);
+}
+
+//=============================================================================
+// Mirrors SendCorrectedChord and the send at the end of ReadDs4RawInput
+static void Replay (
+    const std::vector<SessionChord> & session,
+    bool                              correct,
+    std::wstring *                    text,
+    DecodeStats *                     stats
+) {
+
+    text->clear();
+    stats->letterCount = 0;
+    stats->editCount   = 0;
+    ChordCorrect::Reset();
+
+    unsigned decodeIndex = 0;
+
+    for (size_t i = 0; i < session.size(); ++i) {
+        const unsigned    chordCode = session[i].chordCode;
+        const GkosChord & gkosKey   = gkosKeysAbc[chordCode];
+        if (!correct) {
+            TypeChord(gkosKey, text);
+            continue;
+        }
+
+        ChordCorrect::Edit edit;
+        LARGE_INTEGER      startTime, endTime;
+        QueryPerformanceCounter(&startTime);
+
+        bool handled = false;
+        if (ChordCorrect::IsLetterChord(chordCode)) {
+            ChordCorrect::CommitLetter(chordCode, session[i].uncertainKeys, &edit);
+            ++stats->letterCount;
+            handled = true;
+        }
+        else if (gkosKey.str || gkosKey.vkey == VK_SPACE || gkosKey.vkey == VK_RETURN || gkosKey.vkey == VK_TAB) {
+            ChordCorrect::CommitBoundary(&edit);
+        }
+        else {
+            ChordCorrect::Reset();
+            TypeChord(gkosKey, text);
+            continue;
+        }
+
+        QueryPerformanceCounter(&endTime);
+        const ULONGLONG ticks = ULONGLONG(endTime.QuadPart - startTime.QuadPart);
+        if (decodeIndex == stats->commitTicks.size())
+            stats->commitTicks.push_back(ticks);
+        else
+            stats->commitTicks[decodeIndex] = std::min(stats->commitTicks[decodeIndex], ticks);
+        ++decodeIndex;
+        if (edit.backspaceCount)
+            ++stats->editCount;
+
+        ApplyEdit(edit, text);
+        if (!handled)
+            TypeChord(gkosKey, text);
+    }
+
+}
+
+//=============================================================================
+static unsigned EditDistance (const std::wstring & lhs, const std::wstring & rhs) {
+
+    std::vector<unsigned> prevRow(rhs.size() + 1), row(rhs.size() + 1);
+    for (size_t j = 0; j <= rhs.size(); ++j)
+        prevRow[j] = unsigned(j);
+
+    for (size_t i = 1; i <= lhs.size(); ++i) {
+        row[0] = unsigned(i);
+        for (size_t j = 1; j <= rhs.size(); ++j) {
+            const unsigned substitute = prevRow[j - 1] + (lhs[i - 1] != rhs[j - 1]);
+            row[j] = std::min(substitute, std::min(prevRow[j], row[j - 1]) + 1);
+        }
+        prevRow.swap(row);
+    }
+    return prevRow[rhs.size()];
+
+}
+
+//=============================================================================
+static float CharAccuracy (const std::wstring & text, const std::wstring & expected) {
+    if (expected.empty())
+        return text.empty() ? 1.0f : 0.0f;
+    return 1.0f - float(EditDistance(text, expected)) / expected.size();
+}
+
+//=============================================================================
+int wmain (int argc, wchar_t ** argv) {
+
+    if (argc < 4) {
+        fwprintf(stderr, L"Usage: gkoscorrect <corpus.txt> <session.txt> <expected.txt> [min accuracy %%]\n");
+        return 1;
+    }
+    const float minAccuracy = argc > 4 ? float(_wtof(argv[4])) : 0.0f;
+
+    ChordCorrect::Init(gkosKeysAbc);
+    if (!ChordCorrect::LoadLanguageModel(argv[1])) {
+        fwprintf(stderr, L"Couldn't train the language model from %s\n", argv[1]);
+        return 1;
+    }
+
+    std::vector<SessionChord> session;
+    if (!ReadSession(argv[2], &session)) {
+        fwprintf(stderr, L"Couldn't read any chords from %s\n", argv[2]);
+        return 1;
+    }
+
+    std::wstring expected;
+    if (!ReadText(argv[3], &expected)) {
+        fwprintf(stderr, L"Couldn't read %s\n", argv[3]);
+        return 1;
+    }
+
+    std::wstring typed, corrected;
+    DecodeStats  typedStats, stats;
+    Replay(session, false, &typed, &typedStats);
+    for (unsigned run = 0; run < s_timingRunCount; ++run)
+        Replay(session, true, &corrected, &stats);
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const double usPerTick = 1.0e6 / double(frequency.QuadPart);
+
+    ULONGLONG totalTicks = 0, worstTicks = 0;
+    for (size_t i = 0; i < stats.commitTicks.size(); ++i) {
+        totalTicks += stats.commitTicks[i];
+        worstTicks  = std::max(worstTicks, stats.commitTicks[i]);
+    }
+
+    const float typedAccuracy     = 100.0f * CharAccuracy(typed, expected);
+    const float correctedAccuracy = 100.0f * CharAccuracy(corrected, expected);
+
+    wprintf(L"%u chords, %u letters, %u rewrites\n", unsigned(session.size()), stats.letterCount, stats.editCount);
+    wprintf(L"Char accuracy:  typed %.2f%%, corrected %.2f%% (minimum %.2f%%)\n", typedAccuracy, correctedAccuracy, minAccuracy);
+    wprintf(L"Decode time:    mean %.2f us, worst %.2f us (budget %.0f us)\n",
+        totalTicks * usPerTick / std::max<size_t>(stats.commitTicks.size(), 1), worstTicks * usPerTick, s_decodeBudgetUs);
+    wprintf(L"\n%s\n", corrected.c_str());
+
+    bool passed = true;
+    if (correctedAccuracy < typedAccuracy) {
+        fwprintf(stderr, L"Correction made the text worse\n");
+        passed = false;
+    }
+    if (correctedAccuracy < minAccuracy) {
+        fwprintf(stderr, L"Corrected accuracy is under the minimum\n");
+        passed = false;
+    }
+    if (worstTicks * usPerTick > s_decodeBudgetUs) {
+        fwprintf(stderr, L"Decoding went over budget\n");
+        passed = false;
+    }
+    return passed ? 0 : 1;
+
+}
@@ -0,0 +1,199 @@
+#include "ds4input.h"
+
+namespace Ds4Input {
+
+// Timing
+static const unsigned s_chordMinFrameCount  = 85 / s_frameDelay; // ms / ms-per-frame
+static const unsigned s_chordLeadFrameCount = 60 / s_frameDelay; // Frames before a chord settles that count as its press
+static const unsigned s_idleEnterFrameCount = (MS_PER_SECOND * 5) / s_frameDelay; // Unchanged reports before going low-rate
+
+// Input frames
+static const unsigned s_inputBufferCount    = (MS_PER_SECOND * 3) / s_frameDelay;
+
+// Everything outside motion that a report can change.  Reports that match
+// this skip straight to frame counting.
+struct ChordInput {
+    unsigned keyboardKeys;
+    BYTE     faceAndPov;
+    BYTE     l2Analog;
+    BYTE     r2Analog;
+    BYTE     batteryLevel;
+};
+
+struct InputState {
+    unsigned       inputBufferIndex;
+    Ds4Frame       ds4FrameBuffer[s_inputBufferCount];
+    GkosChordFrame gkosFrameBuffer[s_inputBufferCount];
+
+    ChordInput     chordInput;
+    unsigned       chordStableFrameCount; // Consecutive reports with the current chord code
+    unsigned       idleFrameCount;        // Consecutive reports without a chord change
+    BYTE           batteryLevel;
+
+    Stats          stats;
+};
+
+static InputState s_state;
+
+//=============================================================================
+static unsigned GetRelativeInputBufferIndex (unsigned framesAgo) {
+    return ((s_state.inputBufferIndex + s_inputBufferCount) - framesAgo) % s_inputBufferCount;
+}
+
+//=============================================================================
+static const GkosChordFrame & GetRelativeGkosChordFrame (unsigned framesAgo) {
+    return s_state.gkosFrameBuffer[GetRelativeInputBufferIndex(framesAgo)];
+}
+
+//============================================================================
+static unsigned DecodeDs4Chord (const BYTE * rawDataArray) {
+
+    unsigned povValue = rawDataArray[DS4_BYTE_FACE_AND_POV] & 0x0F;
+    unsigned gkosChord = 0x0;
+    /*
+    if (rawDataArray[DS4_BYTE_L_R_MISC_DIGITAL] & (1 << 0)) // L1
+        gkosChord |= GKOS_KEY_FLAG_1;
+    if ((povValue >= 1 && povValue <= 3) || rawDataArray[DS4_BYTE_L2_ANALOG] >= 0x1F) // POV East OR L2
+        gkosChord |= GKOS_KEY_FLAG_2;
+    if (povValue >= 3 && povValue <= 5) // POV South
+        gkosChord |= GKOS_KEY_FLAG_3;
+    if (rawDataArray[DS4_BYTE_L_R_MISC_DIGITAL] & (1 << 1)) // R1
+        gkosChord |= GKOS_KEY_FLAG_4;
+    if ((rawDataArray[DS4_BYTE_FACE_AND_POV] & (1 << 4)) || rawDataArray[DS4_BYTE_R2_ANALOG] >= 0x1F) // Square OR R2
+        gkosChord |= GKOS_KEY_FLAG_5;
+    if (rawDataArray[DS4_BYTE_FACE_AND_POV] & (1 << 5)) // X
+        gkosChord |= GKOS_KEY_FLAG_6;
+    /*/
+    //if (rawDataArray[DS4_BYTE_L_R_MISC_DIGITAL] & (1 << 0)) // L1
+        //gkosChord |= GKOS_KEY_FLAG_3;
+    if ((povValue >= 1 && povValue <= 3) || rawDataArray[DS4_BYTE_L2_ANALOG] >= 0x1F) // POV East OR L2
+        gkosChord |= GKOS_KEY_FLAG_1;
+    if (povValue >= 3 && povValue <= 5) // POV South
+        gkosChord |= GKOS_KEY_FLAG_2;
+    //if (rawDataArray[DS4_BYTE_L_R_MISC_DIGITAL] & (1 << 1)) // R1
+        //gkosChord |= GKOS_KEY_FLAG_6;
+    if ((rawDataArray[DS4_BYTE_FACE_AND_POV] & (1 << 4)) || rawDataArray[DS4_BYTE_R2_ANALOG] >= 0x1F) // Square OR R2
+        gkosChord |= GKOS_KEY_FLAG_4;
+    if (rawDataArray[DS4_BYTE_FACE_AND_POV] & (1 << 5)) // X
+        gkosChord |= GKOS_KEY_FLAG_5;
+    //*/
+
+    return gkosChord;
+
+}
+
+//=============================================================================
+void Reset () {
+    memset(&s_state, 0, sizeof(s_state));
+    s_state.chordInput.keyboardKeys = unsigned(-1); // Force a full decode of the first report
+    s_state.batteryLevel            = 0xFF;
+    Ds4Motion::Reset();
+}
+
+//=============================================================================
+void ReadReport (const BYTE * rawDataArray, unsigned rawDataSize, unsigned keyboardKeys, Report * report) {
+
+    InputState & state = s_state;
+    memset(report, 0, sizeof(*report));
+
+    state.inputBufferIndex = (state.inputBufferIndex + 1) % s_inputBufferCount;
+    ++state.stats.reportCount;
+
+    // Every report goes in the ring so it stays in step with gkosFrameBuffer
+    Ds4Frame & ds4Frame = state.ds4FrameBuffer[state.inputBufferIndex];
+    memcpy(&ds4Frame, rawDataArray, rawDataSize < sizeof(ds4Frame) ? rawDataSize : sizeof(ds4Frame));
+
+    // Fast path: if none of the bytes outside motion moved, the chord can't
+    // have either.  Skip the battery check and decode, and just count the
+    // frame.
+    ChordInput &   input     = state.chordInput;
+    unsigned       gkosChord = GetRelativeGkosChordFrame(1).chordCode;
+    const unsigned prevChord = gkosChord;
+    if (keyboardKeys                        == input.keyboardKeys &&
+        rawDataArray[DS4_BYTE_FACE_AND_POV]  == input.faceAndPov &&
+        rawDataArray[DS4_BYTE_L2_ANALOG]     == input.l2Analog &&
+        rawDataArray[DS4_BYTE_R2_ANALOG]     == input.r2Analog &&
+        rawDataArray[DS4_BYTE_BATTERY_LEVEL] == input.batteryLevel
+    ) {
+        ++state.stats.fastPathCount;
+    }
+    else {
+        input.keyboardKeys = keyboardKeys;
+        input.faceAndPov   = rawDataArray[DS4_BYTE_FACE_AND_POV];
+        input.l2Analog     = rawDataArray[DS4_BYTE_L2_ANALOG];
+        input.r2Analog     = rawDataArray[DS4_BYTE_R2_ANALOG];
+        input.batteryLevel = rawDataArray[DS4_BYTE_BATTERY_LEVEL];
+
+        if (input.batteryLevel != state.batteryLevel) {
+            state.batteryLevel     = input.batteryLevel;
+            report->batteryChanged = true;
+        }
+
+        // Combine with keyboard-based gkos keys
+        gkosChord = DecodeDs4Chord(rawDataArray) | keyboardKeys;
+    }
+
+    const bool wasPointing  = Ds4Motion::IsActive();
+    report->pointerReady    = Ds4Motion::Update(rawDataArray, &report->pointerMotion);
+    report->pointerStarted  = !wasPointing && Ds4Motion::IsActive();
+
+    GkosChordFrame & gkosFrame = state.gkosFrameBuffer[state.inputBufferIndex];
+    gkosFrame.chordCode = BYTE(gkosChord);
+    gkosFrame.flags     = 0;
+
+    // Any chord change wakes us straight back out of low-rate mode
+    if (gkosChord == prevChord) {
+        if (state.chordStableFrameCount < s_chordMinFrameCount + 1)
+            ++state.chordStableFrameCount;
+        if (state.idleFrameCount < s_idleEnterFrameCount)
+            ++state.idleFrameCount;
+    }
+    else {
+        state.chordStableFrameCount = 1;
+        state.idleFrameCount        = 0;
+    }
+    if (Ds4Motion::IsActive())
+        state.idleFrameCount = 0; // Batched reads would make the pointer stutter
+
+    // The chord was just pressed; that is, it has been held for exactly the
+    // minimum number of frames.
+    if (gkosChord && state.chordStableFrameCount == s_chordMinFrameCount)
+        report->chordCode = gkosChord;
+
+}
+
+//=============================================================================
+bool IsIdle () {
+    return s_state.idleFrameCount >= s_idleEnterFrameCount;
+}
+
+//============================================================================
+// Keys that came or went in the frames just before the chord settled were
+// mis-timed rather than deliberate, so they're the likeliest to be wrong.
+unsigned GetUncertainKeys (unsigned chordCode) {
+    unsigned uncertainKeys = 0;
+    for (unsigned i = s_chordMinFrameCount; i < s_chordMinFrameCount + s_chordLeadFrameCount; ++i) {
+        const unsigned frameChord = GetRelativeGkosChordFrame(i).chordCode;
+        if (!frameChord)
+            break; // All keys were up; nothing earlier belongs to this chord
+        uncertainKeys |= frameChord ^ chordCode;
+    }
+    return uncertainKeys;
+}
+
+//=============================================================================
+BYTE GetBatteryLevel () {
+    return s_state.batteryLevel;
+}
+
+//=============================================================================
+const Stats & GetStats () {
+    return s_state.stats;
+}
+
+//=============================================================================
+void ResetStats () {
+    memset(&s_state.stats, 0, sizeof(s_state.stats));
+}
+
+} // namespace Ds4Input
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ds4motion.h"
+
+// Per-report input handling, kept free of windows and SendInput so gkospower
+// can replay it.  Every DS4 report, together with the keyboard gkos keys read
+// alongside it, goes into a 3 s ring of frames.  Reports whose bytes outside
+// motion match the last report that changed anything take a fast path that
+// skips the decode.  A chord is committed once it has been held for the
+// minimum frame count.  Once the chord has sat unchanged for a while the
+// input goes idle, and the message loop can leave raw input queued and drain
+// it once per poll instead of waking on every report.
+
+namespace Ds4Input {
+
+static const unsigned s_frameDelay    = 4;  // ms per DS4 report
+static const DWORD    s_idlePollDelay = 50; // ms; must stay well under the chord hold time
+
+// What one report produced
+struct Report {
+    unsigned                 chordCode;      // Chord committed by this report, or 0
+    bool                     batteryChanged;
+    bool                     pointerStarted; // The air pointer just became active
+    bool                     pointerReady;   // pointerMotion holds a batch to inject
+    Ds4Motion::PointerMotion pointerMotion;
+};
+
+struct Stats {
+    unsigned reportCount;
+    unsigned fastPathCount;
+};
+
+void Reset ();
+
+// Feed one raw DS4 report.  keyboardKeys are the gkos keys held on the
+// keyboard, already in chord code bits.
+void ReadReport (const BYTE * rawDataArray, unsigned rawDataSize, unsigned keyboardKeys, Report * report);
+
+// The chord has been unchanged long enough to poll for input
+bool IsIdle ();
+
+// Keys that came or went in the frames just before the chord settled
+unsigned GetUncertainKeys (unsigned chordCode);
+
+BYTE GetBatteryLevel ();
+
+const Stats & GetStats ();
+void ResetStats ();
+
+} // namespace Ds4Input
@@ -0,0 +1,248 @@
+#include "ds4motion.h"
+
+namespace Ds4Motion {
+
+// Modifiers (DS4_BYTE_L_R_MISC_DIGITAL)
+static const BYTE     s_pointerButton       = 1 << 0; // L1
+static const BYTE     s_scrollButton        = 1 << 1; // R1
+
+// Sensor scale
+static const int      s_accelOneG           = 8192;
+static const int      s_accelStillTolerance = s_accelOneG / 8;  // |accel| within this of 1g
+static const int      s_gyroStillJitter     = 24;  // Raw change between reports, ~1.5 deg/s
+static const int      s_gyroMaxBiasError    = 160; // Once calibrated, only learn from samples this near the bias
+static const unsigned s_stillFrameCount     = 50;  // 200ms of stillness before trusting bias samples
+static const unsigned s_biasBlendShift      = 5;   // Bias EMA weight 1/32 per still report
+
+// Complementary filter.  Gravity is kept in accel units * 16.  A raw gyro
+// unit is ~1/16.4 deg/s, so one 4ms report turns by raw * 4.26e-6 rad,
+// which is raw * 18 / 2^22.
+static const unsigned s_gravityShift        = 4;
+static const int      s_gyroToAngleMul      = 18;
+static const unsigned s_gyroToAngleShift    = 22;
+static const unsigned s_gravityBlendShift   = 6;   // Pull toward accel 1/64 per report (~250ms)
+
+// Pointer
+static const unsigned s_fracShift           = 12;  // Q12 for the pitch axis and sub-pixel motion
+static const unsigned s_minPitchAxisShift   = 2;   // Pitch axis must be at least 1/4 of gravity to trust
+static const int      s_rateDeadzone        = 48;  // ~3 deg/s of hand tremor
+static const int      s_pointerGain         = 10;  // Q12 pixels per raw rate per report (~1000 px/s at 100 deg/s)
+static const int      s_scrollGain          = 6;   // Q12 wheel units per raw rate per report (~5 notches/s at 100 deg/s)
+static const unsigned s_batchFrameCount     = 4;   // Inject every 16ms
+
+struct MotionState {
+    int      gyroBias[3];   // Raw * 256
+    bool     biasValid;
+    int      prevGyro[3];
+    int      gravity[3];    // Accel * (1 << s_gravityShift)
+    bool     gravityValid;
+    unsigned stillFrames;
+    int      pitchAxis[2];  // Q12 horizontal side axis, in the pad's X/Y plane
+
+    bool     active;
+    int      pointerAccum[2]; // Q12 pixels
+    int      wheelAccum;      // Q12 wheel units
+    unsigned batchFrames;
+};
+
+static MotionState s_state;
+
+//=============================================================================
+static int ReadInt16 (const BYTE * rawDataArray, unsigned byteIndex) {
+    return short(rawDataArray[byteIndex] | (rawDataArray[byteIndex + 1] << 8));
+}
+
+//=============================================================================
+static int Abs (int value) {
+    return value < 0 ? -value : value;
+}
+
+//=============================================================================
+static unsigned SquareRoot (unsigned long long value) {
+    unsigned long long root = 0;
+    unsigned long long bit  = 1ull << 62;
+    while (bit > value)
+        bit >>= 2;
+    while (bit) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root   = (root >> 1) + bit;
+        }
+        else
+            root >>= 1;
+        bit >>= 2;
+    }
+    return unsigned(root);
+}
+
+//=============================================================================
+static int ApplyDeadzone (int rate) {
+    if (rate > s_rateDeadzone)
+        return rate - s_rateDeadzone;
+    if (rate < -s_rateDeadzone)
+        return rate + s_rateDeadzone;
+    return 0;
+}
+
+//=============================================================================
+// Take whole units out of a fixed-point accumulator, leaving the fraction
+static int TakeWhole (int * accum) {
+    const int whole = *accum / (1 << s_fracShift); // Truncates toward zero
+    *accum -= whole * (1 << s_fracShift);
+    return whole;
+}
+
+//=============================================================================
+static void UpdateBias (const int gyro[3], const int accel[3]) {
+
+    MotionState & state = s_state;
+
+    // Steady readings alone could be a slow, steady turn, so once there's a
+    // bias, readings also have to sit near it.  Never learn while pointing.
+    bool still = !state.active;
+    for (unsigned i = 0; i < 3; ++i) {
+        if (Abs(gyro[i] - state.prevGyro[i]) > s_gyroStillJitter)
+            still = false;
+        if (state.biasValid && Abs(gyro[i] - state.gyroBias[i] / 256) > s_gyroMaxBiasError)
+            still = false;
+        state.prevGyro[i] = gyro[i];
+    }
+
+    const long long accelSq = (long long)accel[0] * accel[0] + (long long)accel[1] * accel[1] + (long long)accel[2] * accel[2];
+    const long long minSq   = (long long)(s_accelOneG - s_accelStillTolerance) * (s_accelOneG - s_accelStillTolerance);
+    const long long maxSq   = (long long)(s_accelOneG + s_accelStillTolerance) * (s_accelOneG + s_accelStillTolerance);
+    if (accelSq < minSq || accelSq > maxSq)
+        still = false;
+
+    if (!still) {
+        state.stillFrames = 0;
+        return;
+    }
+    if (state.stillFrames < s_stillFrameCount) {
+        ++state.stillFrames;
+        return;
+    }
+
+    if (!state.biasValid) {
+        for (unsigned i = 0; i < 3; ++i)
+            state.gyroBias[i] = gyro[i] * 256;
+        state.biasValid = true;
+        return;
+    }
+    for (unsigned i = 0; i < 3; ++i)
+        state.gyroBias[i] += (gyro[i] * 256 - state.gyroBias[i]) / (1 << s_biasBlendShift);
+
+}
+
+//=============================================================================
+static void UpdateGravity (const int rate[3], const int accel[3]) {
+
+    MotionState & state = s_state;
+    int * g = state.gravity;
+
+    if (!state.gravityValid) {
+        for (unsigned i = 0; i < 3; ++i)
+            g[i] = accel[i] * (1 << s_gravityShift);
+        state.gravityValid = true;
+        return;
+    }
+
+    // A world-fixed vector seen from the pad turns the opposite way: dg = g x w dt
+    const long long crossX = (long long)g[1] * rate[2] - (long long)g[2] * rate[1];
+    const long long crossY = (long long)g[2] * rate[0] - (long long)g[0] * rate[2];
+    const long long crossZ = (long long)g[0] * rate[1] - (long long)g[1] * rate[0];
+    g[0] += int(crossX * s_gyroToAngleMul / (1ll << s_gyroToAngleShift));
+    g[1] += int(crossY * s_gyroToAngleMul / (1ll << s_gyroToAngleShift));
+    g[2] += int(crossZ * s_gyroToAngleMul / (1ll << s_gyroToAngleShift));
+
+    // ... and the accelerometer slowly corrects the drift
+    for (unsigned i = 0; i < 3; ++i)
+        g[i] += (accel[i] * (1 << s_gravityShift) - g[i]) / (1 << s_gravityBlendShift);
+
+}
+
+//=============================================================================
+void Reset () {
+    memset(&s_state, 0, sizeof(s_state));
+    s_state.pitchAxis[0] = 1 << s_fracShift;
+}
+
+//=============================================================================
+bool IsActive () {
+    return s_state.active;
+}
+
+//=============================================================================
+bool Update (const BYTE * rawDataArray, PointerMotion * motion) {
+
+    MotionState & state = s_state;
+
+    int gyro[3], accel[3], rate[3];
+    gyro[0]  = ReadInt16(rawDataArray, DS4_BYTE_GYRO_X);
+    gyro[1]  = ReadInt16(rawDataArray, DS4_BYTE_GYRO_Y);
+    gyro[2]  = ReadInt16(rawDataArray, DS4_BYTE_GYRO_Z);
+    accel[0] = ReadInt16(rawDataArray, DS4_BYTE_ACCEL_X);
+    accel[1] = ReadInt16(rawDataArray, DS4_BYTE_ACCEL_Y);
+    accel[2] = ReadInt16(rawDataArray, DS4_BYTE_ACCEL_Z);
+
+    UpdateBias(gyro, accel);
+    for (unsigned i = 0; i < 3; ++i)
+        rate[i] = gyro[i] - state.gyroBias[i] / 256;
+    UpdateGravity(rate, accel);
+
+    const BYTE buttons   = rawDataArray[DS4_BYTE_L_R_MISC_DIGITAL];
+    const bool pointing  = (buttons & s_pointerButton) != 0;
+    const bool scrolling = (buttons & s_scrollButton) != 0;
+    if (!pointing && !scrolling) {
+        if (state.active) {
+            state.active          = false;
+            state.pointerAccum[0] = 0;
+            state.pointerAccum[1] = 0;
+            state.wheelAccum      = 0;
+            state.batchFrames     = 0;
+        }
+        return false;
+    }
+    state.active = true;
+
+    // Measure turns in the world, not the pad, so neither roll nor pitch
+    // skews the pointer.  Horizontal motion is the turn about gravity.
+    // Vertical motion is the turn about the horizontal axis across the pad,
+    // gravity x Z, which is (g.y, -g.x, 0).  When the pad points nearly
+    // straight up or down that axis shrinks to accelerometer noise, so keep
+    // the last one that was long enough.
+    const int *              g             = state.gravity;
+    const unsigned long long planeLengthSq = (unsigned long long)((long long)g[0] * g[0] + (long long)g[1] * g[1]);
+    const unsigned long long gravityLength = SquareRoot(planeLengthSq + (unsigned long long)((long long)g[2] * g[2]));
+    const unsigned           planeLength   = SquareRoot(planeLengthSq);
+    if (planeLength && planeLength >= (gravityLength >> s_minPitchAxisShift)) {
+        state.pitchAxis[0] = int((long long)g[1] * (1 << s_fracShift) / planeLength);
+        state.pitchAxis[1] = int(-(long long)g[0] * (1 << s_fracShift) / planeLength);
+    }
+
+    int horizontal = 0;
+    if (gravityLength) {
+        const long long turn = (long long)rate[0] * g[0] + (long long)rate[1] * g[1] + (long long)rate[2] * g[2];
+        horizontal = ApplyDeadzone(int(turn / (long long)gravityLength));
+    }
+    const int vertical = ApplyDeadzone((rate[0] * state.pitchAxis[0] + rate[1] * state.pitchAxis[1]) / (1 << s_fracShift));
+
+    if (pointing) {
+        state.pointerAccum[0] -= horizontal * s_pointerGain;
+        state.pointerAccum[1] -= vertical * s_pointerGain;
+    }
+    if (scrolling)
+        state.wheelAccum += vertical * s_scrollGain;
+
+    if (++state.batchFrames < s_batchFrameCount)
+        return false;
+    state.batchFrames = 0;
+
+    motion->dx    = TakeWhole(&state.pointerAccum[0]);
+    motion->dy    = TakeWhole(&state.pointerAccum[1]);
+    motion->wheel = TakeWhole(&state.wheelAccum);
+    return motion->dx || motion->dy || motion->wheel;
+
+}
+
+} // namespace Ds4Motion
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "misc.h"
+
+// Air pointer from the DS4 gyro and accelerometer.  Every report updates a
+// fixed-point complementary filter (gyro-propagated gravity, pulled toward
+// the accelerometer) and re-learns the gyro bias whenever the pad is still.
+// While L1 is held, turning left/right (about gravity) and nodding (about the
+// horizontal axis across the pad) move the pointer, so holding the pad rolled
+// or pitched doesn't skew it; while R1 is held, nodding scrolls.  Motion is
+// accumulated and handed back in batches rather than injected every report.
+//
+// No allocation and no floating point; one Update() is a few dozen integer
+// multiplies and two integer square roots.
+
+namespace Ds4Motion {
+
+struct PointerMotion {
+    int dx;    // Pixels
+    int dy;
+    int wheel; // WHEEL_DELTA units
+};
+
+void Reset ();
+
+// A motion modifier is held and the pointer is being driven
+bool IsActive ();
+
+// Feed one raw DS4 report.  Returns true (and fills motion) when a batch of
+// pointer motion is ready to inject.
+bool Update (const BYTE * rawDataArray, PointerMotion * motion);
+
+} // namespace Ds4Motion
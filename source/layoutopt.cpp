@@ -0,0 +1,441 @@
+// gkoslayout: offline chord layout optimizer.
+//
+// Reads a text corpus, gathers character and bigram statistics, then runs
+// simulated annealing on every core to reassign the single-character chords
+// of gkosKeysAbc (letters and punctuation).  Virtual keys, the multi-letter
+// word chords and empty chords stay where they are.  The best layout is
+// written out as a gkosKeysAbc table ready to paste into layouts.cpp.
+//
+// Usage: gkoslayout <corpus.txt> [seconds] [output.cpp]
+
+#include "layouts.h"
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <xmmintrin.h>
+
+// Cost model, in rough "finger effort" units
+static const float    s_keyEffort[6]        = { 1.0f, 1.0f, 1.2f, 1.0f, 1.0f, 1.2f }; // Bottom row is a reach
+static const float    s_keyCountEffort[7]   = { 0.0f, 0.0f, 0.6f, 1.5f, 2.6f, 3.8f, 5.0f }; // Extra cost of pressing keys together
+static const float    s_keyChangeEffort     = 0.25f; // Per key pressed or released between chords
+static const float    s_repeatEffort        = 1.0f;  // Same chord twice needs a full release
+
+// Annealing
+static const unsigned s_itemStride          = 64;    // Padded item count, a whole number of SSE vectors per row
+static const unsigned s_stepsPerRun         = 4 * 1000 * 1000;
+static const float    s_startTemperature    = 2.0f;
+static const float    s_endTemperature      = 0.002f;
+static const unsigned s_defaultSeconds      = 60;
+
+// Items are the characters being placed, plus space, which is fixed but
+// matters for transitions.  Rows are padded to s_itemStride with zeros.
+struct Corpus {
+    unsigned       itemCount;
+    unsigned       movableCount;                           // Items [0, movableCount) may move
+    TCHAR          itemChar[s_itemStride];
+    BYTE           stockChord[s_itemStride];
+    float          frequency[s_itemStride];                // Per character typed
+    float          pairFrequency[s_itemStride * s_itemStride]; // Symmetric: P(ab) + P(ba)
+    float          repeatFrequency[s_itemStride];          // P(aa)
+};
+
+struct Layout {
+    BYTE  chord[s_itemStride];
+    float cost;
+};
+
+static Corpus s_corpus;
+static float  s_chordEffort[GKOS_CHORD_COUNT];
+static float  s_transitionEffort[GKOS_CHORD_COUNT][GKOS_CHORD_COUNT];
+
+//=============================================================================
+static unsigned CountBits (unsigned value) {
+    unsigned count = 0;
+    for (; value; value &= value - 1)
+        ++count;
+    return count;
+}
+
+//=============================================================================
+static void InitEffort () {
+
+    for (unsigned chord = 0; chord < GKOS_CHORD_COUNT; ++chord) {
+        float effort = s_keyCountEffort[CountBits(chord)];
+        for (unsigned key = 0; key < 6; ++key) {
+            if (chord & (1 << key))
+                effort += s_keyEffort[key];
+        }
+        s_chordEffort[chord] = effort;
+    }
+
+    for (unsigned a = 0; a < GKOS_CHORD_COUNT; ++a) {
+        for (unsigned b = 0; b < GKOS_CHORD_COUNT; ++b) {
+            s_transitionEffort[a][b] = CountBits(a ^ b) * s_keyChangeEffort;
+            if (a == b)
+                s_transitionEffort[a][b] += s_repeatEffort;
+        }
+    }
+
+}
+
+//=============================================================================
+static bool LoadCorpus (const char * path) {
+
+    Corpus & corpus = s_corpus;
+    memset(&corpus, 0, sizeof(corpus));
+
+    // Every single-character chord is movable
+    for (unsigned chord = 1; chord < GKOS_CHORD_COUNT; ++chord) {
+        const TCHAR * str = gkosKeysAbc[chord].str;
+        if (!str || !str[0] || str[1] || unsigned(str[0]) >= 0x80)
+            continue;
+        corpus.itemChar[corpus.itemCount]   = str[0];
+        corpus.stockChord[corpus.itemCount] = BYTE(chord);
+        ++corpus.itemCount;
+    }
+    corpus.movableCount = corpus.itemCount;
+
+    for (unsigned chord = 1; chord < GKOS_CHORD_COUNT; ++chord) {
+        if (gkosKeysAbc[chord].vkey != VK_SPACE)
+            continue;
+        corpus.itemChar[corpus.itemCount]   = L' ';
+        corpus.stockChord[corpus.itemCount] = BYTE(chord);
+        ++corpus.itemCount;
+        break;
+    }
+
+    int charItem[0x80];
+    for (unsigned ch = 0; ch < 0x80; ++ch)
+        charItem[ch] = -1;
+    for (unsigned i = 0; i < corpus.itemCount; ++i)
+        charItem[corpus.itemChar[i]] = int(i);
+
+    FILE * file = NULL;
+    if (fopen_s(&file, path, "rb") != 0 || !file)
+        return false;
+
+    static double s_counts[s_itemStride];
+    static double s_pairCounts[s_itemStride][s_itemStride];
+    memset(s_counts, 0, sizeof(s_counts));
+    memset(s_pairCounts, 0, sizeof(s_pairCounts));
+
+    double total = 0;
+    int    prev  = -1;
+    char   readBuf[4096];
+    size_t readCount;
+    while ((readCount = fread(readBuf, 1, sizeof(readBuf), file)) > 0) {
+        for (size_t i = 0; i < readCount; ++i) {
+            unsigned ch = BYTE(readBuf[i]);
+            if (ch >= 'A' && ch <= 'Z')
+                ch += 'a' - 'A';
+            const int item = ch < 0x80 ? charItem[ch] : -1;
+            if (item < 0) {
+                prev = -1; // Untypeable characters break the chain
+                continue;
+            }
+            s_counts[item] += 1;
+            total          += 1;
+            if (prev >= 0)
+                s_pairCounts[prev][item] += 1;
+            prev = item;
+        }
+    }
+    fclose(file);
+
+    if (total == 0)
+        return false;
+
+    for (unsigned i = 0; i < corpus.itemCount; ++i) {
+        corpus.frequency[i]       = float(s_counts[i] / total);
+        corpus.repeatFrequency[i] = float(s_pairCounts[i][i] / total);
+        for (unsigned j = 0; j < corpus.itemCount; ++j) {
+            if (i != j)
+                corpus.pairFrequency[i * s_itemStride + j] = float((s_pairCounts[i][j] + s_pairCounts[j][i]) / total);
+        }
+    }
+
+    return true;
+
+}
+
+//=============================================================================
+static float EvaluateLayout (const Layout & layout) {
+
+    const Corpus & corpus = s_corpus;
+    float cost = 0;
+    for (unsigned i = 0; i < corpus.itemCount; ++i) {
+        const unsigned a = layout.chord[i];
+        cost += corpus.frequency[i] * s_chordEffort[a];
+        cost += corpus.repeatFrequency[i] * s_transitionEffort[a][a];
+        for (unsigned j = i + 1; j < corpus.itemCount; ++j)
+            cost += corpus.pairFrequency[i * s_itemStride + j] * s_transitionEffort[a][layout.chord[j]];
+    }
+    return cost;
+
+}
+
+//=============================================================================
+static float AverageKeysPerChar (const Layout & layout) {
+    float keys = 0;
+    for (unsigned i = 0; i < s_corpus.itemCount; ++i)
+        keys += s_corpus.frequency[i] * CountBits(layout.chord[i]);
+    return keys;
+}
+
+//=============================================================================
+// Worker state.  transition[i][k] mirrors s_transitionEffort for the chords
+// items i and k currently sit on, so a swap's cost change is a pair of
+// contiguous row walks.  The walk is written with SSE because MSVC won't
+// vectorize a float sum under /fp:precise.
+struct Annealer {
+    Layout   layout;
+    float    transition[s_itemStride * s_itemStride];
+    unsigned seed;
+
+    unsigned Random () {
+        seed = seed * 1664525 + 1013904223;
+        return seed >> 8;
+    }
+
+    float RandomUnit () {
+        return float(Random() & 0xFFFF) / 65536.0f;
+    }
+
+    void Reset (const Layout & start) {
+        layout = start;
+        memset(transition, 0, sizeof(transition));
+        for (unsigned i = 0; i < s_corpus.itemCount; ++i) {
+            for (unsigned k = 0; k < s_corpus.itemCount; ++k)
+                transition[i * s_itemStride + k] = s_transitionEffort[layout.chord[i]][layout.chord[k]];
+        }
+    }
+
+    float SwapDelta (unsigned i, unsigned j) const {
+
+        const Corpus & corpus = s_corpus;
+        const BYTE     ci     = layout.chord[i];
+        const BYTE     cj     = layout.chord[j];
+        const float *  pairI  = corpus.pairFrequency + i * s_itemStride;
+        const float *  pairJ  = corpus.pairFrequency + j * s_itemStride;
+        const float *  transI = transition + i * s_itemStride;
+        const float *  transJ = transition + j * s_itemStride;
+
+        // Every other item k sees i and j trade places.  Two accumulators
+        // keep consecutive adds from waiting on each other.  Rows aren't
+        // 16-byte aligned on the 32-bit stack, so use unaligned loads.
+        __m128 sum0 = _mm_setzero_ps();
+        __m128 sum1 = _mm_setzero_ps();
+        for (unsigned k = 0; k < s_itemStride; k += 8) {
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(
+                _mm_sub_ps(_mm_loadu_ps(pairI + k), _mm_loadu_ps(pairJ + k)),
+                _mm_sub_ps(_mm_loadu_ps(transJ + k), _mm_loadu_ps(transI + k))
+            ));
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(
+                _mm_sub_ps(_mm_loadu_ps(pairI + k + 4), _mm_loadu_ps(pairJ + k + 4)),
+                _mm_sub_ps(_mm_loadu_ps(transJ + k + 4), _mm_loadu_ps(transI + k + 4))
+            ));
+        }
+        sum0 = _mm_add_ps(sum0, sum1);
+        sum0 = _mm_add_ps(sum0, _mm_movehl_ps(sum0, sum0));
+        sum0 = _mm_add_ss(sum0, _mm_shuffle_ps(sum0, sum0, 1));
+        float pairDelta = _mm_cvtss_f32(sum0);
+
+        // The loop above also walked k == i and k == j; take those back out.
+        // The i-j pair itself is symmetric and doesn't change.
+        pairDelta -= (pairI[i] - pairJ[i]) * (transJ[i] - transI[i]);
+        pairDelta -= (pairI[j] - pairJ[j]) * (transJ[j] - transI[j]);
+
+        return
+            pairDelta +
+            (corpus.frequency[i] - corpus.frequency[j]) * (s_chordEffort[cj] - s_chordEffort[ci]) +
+            (corpus.repeatFrequency[i] - corpus.repeatFrequency[j]) * (s_transitionEffort[cj][cj] - s_transitionEffort[ci][ci]);
+
+    }
+
+    void Swap (unsigned i, unsigned j) {
+        std::swap(layout.chord[i], layout.chord[j]);
+        for (unsigned k = 0; k < s_itemStride; ++k)
+            std::swap(transition[i * s_itemStride + k], transition[j * s_itemStride + k]);
+        for (unsigned k = 0; k < s_itemStride; ++k)
+            std::swap(transition[k * s_itemStride + i], transition[k * s_itemStride + j]);
+    }
+
+    // One annealing run from the given start; returns the best layout seen
+    Layout Run (const Layout & start, unsigned long long * evaluations) {
+
+        Reset(start);
+        layout.cost = EvaluateLayout(layout);
+        Layout best = layout;
+
+        const unsigned movable = s_corpus.movableCount;
+        const float    cooling = powf(s_endTemperature / s_startTemperature, 1.0f / s_stepsPerRun);
+        float          temperature = s_startTemperature * best.cost / 100.0f;
+        for (unsigned step = 0; step < s_stepsPerRun; ++step, temperature *= cooling) {
+            const unsigned i = Random() % movable;
+            const unsigned j = Random() % movable;
+            if (i == j)
+                continue;
+
+            const float delta = SwapDelta(i, j);
+            if (delta > 0 && RandomUnit() >= expf(-delta / temperature))
+                continue;
+
+            Swap(i, j);
+            layout.cost += delta;
+            if (layout.cost < best.cost)
+                best = layout;
+        }
+
+        *evaluations += s_stepsPerRun;
+        best.cost = EvaluateLayout(best); // Drop accumulated float drift
+        return best;
+
+    }
+};
+
+//=============================================================================
+static const char * VirtualKeyName (unsigned short vkey) {
+    switch (vkey) {
+        case VK_BACK:     return "VK_BACK";
+        case VK_TAB:      return "VK_TAB";
+        case VK_RETURN:   return "VK_RETURN";
+        case VK_ESCAPE:   return "VK_ESCAPE";
+        case VK_SPACE:    return "VK_SPACE";
+        case VK_PRIOR:    return "VK_PRIOR";
+        case VK_NEXT:     return "VK_NEXT";
+        case VK_END:      return "VK_END";
+        case VK_HOME:     return "VK_HOME";
+        case VK_LEFT:     return "VK_LEFT";
+        case VK_UP:       return "VK_UP";
+        case VK_RIGHT:    return "VK_RIGHT";
+        case VK_DOWN:     return "VK_DOWN";
+        case VK_INSERT:   return "VK_INSERT";
+        case VK_DELETE:   return "VK_DELETE";
+        case VK_LSHIFT:   return "VK_LSHIFT";
+        case VK_LCONTROL: return "VK_LCONTROL";
+        case VK_LMENU:    return "VK_LMENU";
+    }
+    return NULL;
+}
+
+//=============================================================================
+static void WriteLayoutTable (FILE * out, const Layout & layout) {
+
+    const TCHAR * chordStr[GKOS_CHORD_COUNT];
+    TCHAR         movedChar[GKOS_CHORD_COUNT][2];
+    for (unsigned chord = 0; chord < GKOS_CHORD_COUNT; ++chord)
+        chordStr[chord] = gkosKeysAbc[chord].str;
+    for (unsigned i = 0; i < s_corpus.movableCount; ++i) {
+        const BYTE chord = layout.chord[i];
+        movedChar[chord][0] = s_corpus.itemChar[i];
+        movedChar[chord][1] = 0;
+        chordStr[chord]     = movedChar[chord];
+    }
+
+    fprintf(out, "GkosChord gkosKeysAbc[] = {\n");
+    for (unsigned chord = 0; chord < GKOS_CHORD_COUNT; ++chord) {
+        char str[32] = "NULL";
+        if (chordStr[chord]) {
+            char * dst = str;
+            *dst++ = 'L';
+            *dst++ = '"';
+            for (const TCHAR * src = chordStr[chord]; *src; ++src) {
+                if (*src == L'"' || *src == L'\\')
+                    *dst++ = '\\';
+                *dst++ = char(*src);
+            }
+            *dst++ = '"';
+            *dst   = 0;
+        }
+
+        const unsigned short vkey     = gkosKeysAbc[chord].vkey;
+        const char *         vkeyName = VirtualKeyName(vkey);
+        if (vkeyName)
+            fprintf(out, "    { %s, %s },", str, vkeyName);
+        else
+            fprintf(out, "    { %s, %u },", str, vkey);
+        fprintf(out, " // 0x%02X\n", chord);
+    }
+    fprintf(out, "};\n");
+
+}
+
+//=============================================================================
+int main (int argc, char ** argv) {
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: gkoslayout <corpus.txt> [seconds] [output.cpp]\n");
+        return 1;
+    }
+    const unsigned seconds = argc > 2 ? unsigned(atoi(argv[2])) : s_defaultSeconds;
+
+    InitEffort();
+    if (!LoadCorpus(argv[1])) {
+        fprintf(stderr, "Couldn't read any typeable text from %s\n", argv[1]);
+        return 1;
+    }
+
+    Layout stock;
+    memset(&stock, 0, sizeof(stock));
+    memcpy(stock.chord, s_corpus.stockChord, sizeof(stock.chord));
+    stock.cost = EvaluateLayout(stock);
+
+    // Independent annealing runs on every core until time's up; keep the best
+    const unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+    const auto     deadline    = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    const auto     startTime   = std::chrono::steady_clock::now();
+
+    std::mutex               bestMutex;
+    Layout                   best        = stock;
+    unsigned long long       evaluations = 0;
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < threadCount; ++t) {
+        threads.push_back(std::thread([&, t] () {
+            Annealer annealer;
+            annealer.seed = 0x9E3779B9u * (t + 1);
+
+            unsigned long long threadEvaluations = 0;
+            Layout             start             = stock;
+            do {
+                // Restart from a shuffle of the stock layout so runs explore different basins
+                for (unsigned i = s_corpus.movableCount - 1; i > 0; --i)
+                    std::swap(start.chord[i], start.chord[annealer.Random() % (i + 1)]);
+
+                const Layout result = annealer.Run(start, &threadEvaluations);
+                std::lock_guard<std::mutex> lock(bestMutex);
+                if (result.cost < best.cost)
+                    best = result;
+            } while (std::chrono::steady_clock::now() < deadline);
+
+            std::lock_guard<std::mutex> lock(bestMutex);
+            evaluations += threadEvaluations;
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); ++t)
+        threads[t].join();
+
+    const double minutes = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count() / 60.0;
+    const float  stockKeys = AverageKeysPerChar(stock);
+    const float  bestKeys  = AverageKeysPerChar(best);
+    fprintf(stderr, "%u threads, %.1f M candidate layouts/min\n", threadCount, evaluations / 1.0e6 / minutes);
+    fprintf(stderr, "Effort per char:  stock %.3f, optimized %.3f (%.1f%% less)\n",
+        stock.cost, best.cost, 100.0f * (stock.cost - best.cost) / stock.cost);
+    fprintf(stderr, "Keys per char:    stock %.3f, optimized %.3f (%.1f%% fewer keystrokes)\n",
+        stockKeys, bestKeys, 100.0f * (stockKeys - bestKeys) / stockKeys);
+
+    FILE * out = stdout;
+    if (argc > 3 && (fopen_s(&out, argv[3], "w") != 0 || !out)) {
+        fprintf(stderr, "Couldn't write %s\n", argv[3]);
+        return 1;
+    }
+    WriteLayoutTable(out, best);
+    if (out != stdout)
+        fclose(out);
+
+    return 0;
+
+}
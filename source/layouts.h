@@ -0,0 +1,9 @@
+#pragma once
+
+#include "misc.h"
+
+static const unsigned GKOS_CHORD_COUNT = 64;
+
+// Chord code -> output, one entry per combination of the six gkos keys
+extern GkosChord gkosKeysAbc[GKOS_CHORD_COUNT];
+extern GkosChord gkosKeysSymb[GKOS_CHORD_COUNT];
@@ -0,0 +1,40 @@
+// gkosmacros: times the chord macro compiler and matcher.
+//
+// Compiles a synthetic set of random 2-8 chord triggers into a temporary
+// table, maps it and matches a stream of random chords through it, then
+// deletes the table.  Reports the table size, compile and map time, and
+// the cost of one committed chord.
+//
+// Usage: gkosmacros <macro count>
+
+#include "chordmacros.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static const TCHAR * s_compiledPath = L"gkos_macros_bench.bin";
+
+//=============================================================================
+int wmain (int argc, wchar_t ** argv) {
+
+    const unsigned macroCount = argc > 1 ? unsigned(_wtoi(argv[1])) : 0;
+    if (!macroCount) {
+        fwprintf(stderr, L"Usage: gkosmacros <macro count>\n");
+        return 1;
+    }
+
+    ChordMacros::BenchmarkResult result;
+    const bool ran = ChordMacros::RunBenchmark(macroCount, s_compiledPath, &result);
+    DeleteFile(s_compiledPath);
+    if (!ran) {
+        fwprintf(stderr, L"Couldn't compile and map %s\n", s_compiledPath);
+        return 1;
+    }
+
+    wprintf(L"%u macros, %u states, %.1f MB table\n", macroCount, result.stateCount, result.fileBytes / (1024.0 * 1024.0));
+    wprintf(L"Compile:  %.0f ms\n", result.compileMs);
+    wprintf(L"Map:      %.0f us\n", result.mapUs);
+    wprintf(L"Match:    %u chords in %.0f ms, %.1f ns per chord (%u matches)\n",
+        result.chordCount, result.matchMs, result.matchMs * 1.0e6 / result.chordCount, result.matchCount);
+    return 0;
+
+}
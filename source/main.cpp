@@ -1,23 +1,41 @@
 #include "misc.h"
-
-// Timing
-static const unsigned s_ds4FrameDelay         = 4; // DS4 frame rate
-static const unsigned s_chordMinFrameCount    = 85 / s_ds4FrameDelay; // ms / ms-per-frame
-
-// Input frames
-static const unsigned s_inputBufferCount      = (MS_PER_SECOND * 3) / s_ds4FrameDelay;
-static unsigned       s_inputBufferIndex      = 0;
-static Ds4Frame       s_ds4FrameBuffer[s_inputBufferCount];
-static GkosChordFrame s_gkosFrameBuffer[s_inputBufferCount];
+#include "chordcorrect.h"
+#include "chordmacros.h"
+#include "ds4input.h"
+#include "layouts.h"
+#include <stdio.h>
+
+// Chord correction
+static const TCHAR *  s_chordCorrectCorpus    = L"gkos_corpus.txt";
+static bool           s_chordCorrectEnabled   = false;
+static const TCHAR *  s_sessionPath           = L"gkos_session.txt"; // Committed chords, for replay with gkoscorrect
+static FILE *         s_sessionFile           = NULL;
+
+// Macros
+static const TCHAR *  s_macroSource           = L"gkos_macros.txt";
+static const TCHAR *  s_macroCompiled         = L"gkos_macros.bin";
+
+// Power
+static const DWORD    s_powerStatsDelay       = MS_PER_SECOND * 60;
+
+struct PowerStats {
+    DWORD     startTime;
+    ULONGLONG startCpuTime; // 100ns units
+    unsigned  wakeupCount;
+};
+static PowerStats s_powerStats;
 
 // Windows stuff
 static HINSTANCE g_mainWindowHandle = NULL;
+static HWND      g_mainWindow       = NULL;
 
 namespace GkosDll {
     typedef bool (*GkosKeyCheck) (unsigned gkosKeyNum);
+    typedef unsigned (*GkosKeyState) ();
 
     static HMODULE      g_dllHandle                = NULL;
     static GkosKeyCheck g_IsGkosKeyboardKeyPressed = NULL;
+    static GkosKeyState g_GetGkosKeyboardKeyState  = NULL;
 } // namespace GkosDll
 
 // Higher-level key events
@@ -25,147 +43,71 @@ namespace GkosDll {
 //static unsigned       s_eventBufferIndex      = 0;
 
 
-GkosChord gkosKeysAbc[] = {
-    { NULL, 0 }, // Meaningless no-key placeholder
-    { L"a", 0 }, // 1
-    { L"b", 0 }, // 2
-    { L"o", 0 },
-    { L"c", 0 }, // 4
-    { L"th", 0 }, // Extra 'th' key
-    { L"s", 0 },
-    { NULL, VK_BACK },
-    { L"t", 0 }, // 8
-    { NULL, VK_UP },
-    { L"'", 0 },
-    { L"p", 0 },
-    { L"!", 0 },
-    { L"that ", 0 }, // Extra 'th' key combo with key 4
-    { L"d", 0 },
-    { NULL, VK_LEFT },
-    { L"e", 0 }, // 16
-    { L"-", 0 },
-    { NULL, VK_LSHIFT }, // TODO : Double-hitting shift enters CapsLock (and symbol lock?)
-    { L"q", 0 },
-    { L",", 0 },
-    { L"the ", 0 }, // Extra 'th' key combo with key 5
-    { L"u", 0 },
-    { NULL, 0 }, // <  ?  (Word Left)
-    { L"i", 0 },
-    { L"h", 0 },
-    { L"g", 0 },
-    { NULL, VK_PRIOR }, // PageUp
-    { L"j", 0 },
-    { L"to ", 0 },
-    { L"/", 0 },
-    { NULL, VK_ESCAPE },
-    { L"r", 0 }, // 32
-    { L"?", 0 },
-    { L".", 0 },
-    { L"f", 0 },
-    { NULL, VK_DOWN },
-    { L"of ", 0 }, // Extra 'th' key combo with key 6
-    { L"v", 0 },
-    { NULL, VK_HOME },
-    { L"w", 0 },
-    { L"x", 0 },
-    { L"y", 0 },
-    { NULL, VK_INSERT },
-    { L"z", 0 },
-    { NULL, 0 }, // TODO : SYMB (when shifted?).  Android keyboard does SYMB anyway -- maybe one instead of lock?
-    { L"wh", 0 },
-    { NULL, VK_LCONTROL },
-    { L"n", 0 },
-    { L"l", 0 },
-    { L"m", 0 },
-    { L"\\", 0 },
-    { L"k", 0 },
-    { L"and ", 0 }, // Extra 'th' key combo with keys 5 and 6
-    { NULL, VK_NEXT }, // PageDown
-    { NULL, VK_LMENU }, // Alt
-    { NULL, VK_SPACE },
-    { NULL, VK_RIGHT },
-    { NULL, 0 }, // >  ?  (Word Right)
-    { NULL, VK_RETURN },
-    { NULL, VK_END },
-    { NULL, VK_TAB },
-    { NULL, VK_DELETE },
-    { NULL, 0 }, // TODO : ABC-123 toggle
-};
-GkosChord gkosKeysSymb[] = {
-    { NULL, 0 }, // Meaningless no-key placeholder
-    { L"1", 0 }, // 1
-    { L"2", 0 }, // 2
-    { L"+", 0 },
-    { L"3", 0 }, // 4
-    { L")", 0 },
-    { L"*", 0 },
-    { NULL, 0 },
-    { L"4", 0 }, // 8
-    { NULL, 0 },
-    { L"\"", 0 },
-    { L"%", 0 },
-    { L"|", 0 },
-    { L"]", 0 },
-    { L"$", 0 },
-    { NULL, 0 },
-    { L"5", 0 }, // 16
-    { L"_", 0 },
-    { NULL, 0 }, // TODO : Double-hitting shift enters CapsLock (and symbol lock?)
-    { L"=", 0 },
-    { L";", 0 },
-    { L">", 0 },
-    { NULL, 0 }, // Euros
-    { NULL, 0 }, // <  ?
-    { L"0", 0 },
-    { L"7", 0 },
-    { L"8", 0 },
-    { NULL, 0 }, // PageUp
-    { L"9", 0 },
-    { NULL, 0 }, // Funky 'ins' symbol? 011101b
-    { L"", 0 },
-    { NULL, 0 },
-    { L"6", 0 }, // 32
-    { L"~", 0 },
-    { L":", 0 },
-    { L"^", 0 },
-    { NULL, 0 }, // Down arrow
-    { L"}", 0 },
-    { NULL, 0 }, // (British pounds currency symbol)
-    { NULL, 0 },
-    { L"(", 0 },
-    { L"[", 0 },
-    { L"<", 0 },
-    { NULL, 0 }, // Insert
-    { L"{", 0 },
-    { NULL, 0 }, // TODO : SYMB (when shifted?).  Android keyboard does SYMB anyway -- maybe one instead of lock?
-    { NULL, 0 }, // Section symbol
-    { NULL, 0 }, // Control
-    { L"#", 0 },
-    { L"@", 0 },
-    { NULL, 0 }, // 1/2 symbol
-    { L"`", 0 }, // Backtick
-    { L"&", 0 },
-    { NULL, 0 }, // Extra 'th' key combo with keys 5 and 6 (elipses/and/_ould)
-    { NULL, 0 }, // PageDown
-    { NULL, 0 }, // Alt
-    { NULL, 0 }, // Space
-    { NULL, 0 }, // Right arrow
-    { NULL, 0 }, // >  ?  (Next Word)
-    { NULL, 0 }, // Enter
-    { NULL, 0 }, // End
-    { NULL, 0 }, // Tab
-    { NULL, 0 }, // Delete
-    { NULL, 0 }, // TODO : ABC-123 toggle
-};
+//=============================================================================
+static ULONGLONG GetProcessCpuTime () {
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+        return 0;
+
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart  = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart    = userTime.dwLowDateTime;
+    user.HighPart   = userTime.dwHighDateTime;
+    return kernel.QuadPart + user.QuadPart;
+}
 
 //=============================================================================
-static unsigned GetRelativeInputBufferIndex (unsigned framesAgo) {
-    return ((s_inputBufferIndex + s_inputBufferCount) - framesAgo) % s_inputBufferCount;
+static void ResetPowerStats () {
+    memset(&s_powerStats, 0, sizeof(s_powerStats));
+    s_powerStats.startTime    = GetTickCount();
+    s_powerStats.startCpuTime = GetProcessCpuTime();
+    Ds4Input::ResetStats();
 }
 
 //=============================================================================
-static const GkosChordFrame & GetRelativeGkosChordFrame (unsigned framesAgo) {
-    return s_gkosFrameBuffer[GetRelativeInputBufferIndex(framesAgo)];
+static void UpdatePowerStats () {
+
+    const DWORD elapsed = GetTickCount() - s_powerStats.startTime;
+    if (elapsed < s_powerStatsDelay)
+        return;
+
+    // Normalize everything to per-minute so idle, light and heavy sessions
+    // compare directly, and with gkospower's replays
+    const Ds4Input::Stats & inputStats = Ds4Input::GetStats();
+    const ULONGLONG cpuUs      = (GetProcessCpuTime() - s_powerStats.startCpuTime) / 10;
+    const ULONGLONG cpuUsMin   = cpuUs * s_powerStatsDelay / elapsed;
+    const unsigned  wakeupsMin = unsigned(ULONGLONG(s_powerStats.wakeupCount) * s_powerStatsDelay / elapsed);
+    const unsigned  reportsMin = unsigned(ULONGLONG(inputStats.reportCount) * s_powerStatsDelay / elapsed);
+    const unsigned  fastMin    = unsigned(ULONGLONG(inputStats.fastPathCount) * s_powerStatsDelay / elapsed);
+
+    TCHAR buf[160];
+    swprintf_s(
+        buf,
+        L"Power: %u wakeups/min, %u reports/min (%u fast path), %llu us CPU/min, %s\n",
+        wakeupsMin,
+        reportsMin,
+        fastMin,
+        cpuUsMin,
+        Ds4Input::IsIdle() ? L"low-rate" : L"active"
+    );
+    OutputDebugString(buf);
+
+    ResetPowerStats();
+
+}
+
+//=============================================================================
+static void ShowDs4Battery (BYTE batteryLevel) {
+
+    TCHAR buf[64];
+    swprintf_s(buf, L"gkos Window - DS4 battery 0x%02X", batteryLevel);
+    if (g_mainWindow)
+        SetWindowText(g_mainWindow, buf);
+
+    swprintf_s(buf, L"DS4 battery level 0x%02X\n", batteryLevel);
+    OutputDebugString(buf);
+
 }
 
 //=============================================================================
@@ -211,6 +153,159 @@ void ListDevices () {
 
 }
 
+//============================================================================
+static void SendKeyTaps (const WORD * vkeys, unsigned vkeyCount) {
+
+    INPUT ins[32];
+    const unsigned tapsPerSend = (sizeof(ins) / sizeof(ins[0])) / 2;
+    while (vkeyCount) {
+        const unsigned tapCount = vkeyCount < tapsPerSend ? vkeyCount : tapsPerSend;
+        memset(ins, 0, sizeof(ins));
+        for (unsigned i = 0; i < tapCount; ++i) {
+            ins[i * 2 + 0].type       = INPUT_KEYBOARD;
+            ins[i * 2 + 0].ki.wVk     = vkeys[i];
+            ins[i * 2 + 1].type       = INPUT_KEYBOARD;
+            ins[i * 2 + 1].ki.wVk     = vkeys[i];
+            ins[i * 2 + 1].ki.dwFlags = KEYEVENTF_KEYUP;
+        }
+        SendInput(tapCount * 2, ins, sizeof(ins[0]));
+        vkeys     += tapCount;
+        vkeyCount -= tapCount;
+    }
+
+}
+
+//============================================================================
+static bool CharToVirtualKey (TCHAR ch, WORD * vkey) {
+    // Note: This doesn't handle numpad keys
+    SHORT vkeyAndShift = VkKeyScanEx(ch, NULL);
+    if (vkeyAndShift == -1)
+        return false;
+    *vkey = WORD(vkeyAndShift & 0xFF);
+    return true;
+}
+
+//============================================================================
+static void SendChordCorrectEdit (const ChordCorrect::Edit & edit) {
+
+    WORD     vkeys[ChordCorrect::s_maxLag * 2 + ChordCorrect::s_maxChordLetters];
+    unsigned vkeyCount = 0;
+    for (unsigned i = 0; i < edit.backspaceCount; ++i)
+        vkeys[vkeyCount++] = VK_BACK;
+    for (unsigned i = 0; i < edit.charCount; ++i) {
+        if (CharToVirtualKey(edit.chars[i], &vkeys[vkeyCount]))
+            ++vkeyCount;
+    }
+    SendKeyTaps(vkeys, vkeyCount);
+
+}
+
+//============================================================================
+static void SendMacroExpansion (const ChordMacros::Expansion & expansion) {
+
+    WORD backspace = VK_BACK;
+    for (unsigned i = 0; i < expansion.eraseCount; ++i)
+        SendKeyTaps(&backspace, 1);
+
+    // Characters go in as unicode so case and symbols come through regardless of layout
+    INPUT ins[32];
+    unsigned insCount = 0;
+    memset(ins, 0, sizeof(ins));
+    for (unsigned i = 0; i < expansion.keyCount; ++i) {
+        const DWORD key = expansion.keys[i];
+        for (unsigned up = 0; up < 2; ++up) {
+            INPUT & in = ins[insCount++];
+            in.type = INPUT_KEYBOARD;
+            if (key & ChordMacros::MACRO_KEY_VKEY) {
+                in.ki.wVk     = WORD(key & 0xFF);
+                in.ki.dwFlags = up ? KEYEVENTF_KEYUP : 0;
+            }
+            else {
+                in.ki.wScan   = WORD(key);
+                in.ki.dwFlags = KEYEVENTF_UNICODE | (up ? KEYEVENTF_KEYUP : 0);
+            }
+        }
+
+        if (insCount == sizeof(ins) / sizeof(ins[0]) || i + 1 == expansion.keyCount) {
+            SendInput(insCount, ins, sizeof(ins[0]));
+            insCount = 0;
+            memset(ins, 0, sizeof(ins));
+        }
+    }
+
+}
+
+//============================================================================
+static void SendPointerMotion (const Ds4Motion::PointerMotion & motion) {
+
+    INPUT ins[2];
+    UINT  insCount = 0;
+    memset(ins, 0, sizeof(ins));
+    if (motion.dx || motion.dy) {
+        ins[insCount].type       = INPUT_MOUSE;
+        ins[insCount].mi.dx      = motion.dx;
+        ins[insCount].mi.dy      = motion.dy;
+        ins[insCount].mi.dwFlags = MOUSEEVENTF_MOVE;
+        ++insCount;
+    }
+    if (motion.wheel) {
+        ins[insCount].type         = INPUT_MOUSE;
+        ins[insCount].mi.mouseData = DWORD(motion.wheel);
+        ins[insCount].mi.dwFlags   = MOUSEEVENTF_WHEEL;
+        ++insCount;
+    }
+    SendInput(insCount, ins, sizeof(ins[0]));
+
+}
+
+//============================================================================
+// Returns true if the chord was fully handled (typed) by the corrector.
+static bool SendCorrectedChord (unsigned gkosChord) {
+
+    const GkosChord & gkosKey = gkosKeysAbc[gkosChord];
+    ChordCorrect::Edit edit;
+
+    LARGE_INTEGER startTime, endTime, frequency;
+    QueryPerformanceCounter(&startTime);
+
+    bool handled = false;
+    if (ChordCorrect::IsLetterChord(gkosChord)) {
+        ChordCorrect::CommitLetter(gkosChord, Ds4Input::GetUncertainKeys(gkosChord), &edit);
+        handled = true;
+    }
+    else if (gkosKey.str || gkosKey.vkey == VK_SPACE || gkosKey.vkey == VK_RETURN || gkosKey.vkey == VK_TAB) {
+        ChordCorrect::CommitBoundary(&edit);
+    }
+    else {
+        // Anything else may move the cursor; what's on screen is no longer known
+        ChordCorrect::Reset();
+        return false;
+    }
+
+    QueryPerformanceCounter(&endTime);
+    QueryPerformanceFrequency(&frequency);
+
+    TCHAR buf[96];
+    swprintf_s(
+        buf,
+        L"Correction: %u back, \"%s\" (%u us)\n",
+        edit.backspaceCount,
+        edit.chars,
+        unsigned((endTime.QuadPart - startTime.QuadPart) * 1000000 / frequency.QuadPart)
+    );
+    OutputDebugString(buf);
+
+    SendChordCorrectEdit(edit);
+    return handled;
+
+}
+
+//============================================================================
+static unsigned ReadGkosKeyboardKeys () {
+    // The DLL numbers keys from 1; chord codes use bits 0-5
+    return (GkosDll::g_GetGkosKeyboardKeyState() >> 1) & 0x3F;
+}
+
 //============================================================================
 void ReadDs4RawInput (
     unsigned     rawDataCount,
@@ -218,96 +313,62 @@ void ReadDs4RawInput (
     const BYTE * rawDataArray
 ) {
 
-    s_inputBufferIndex = (s_inputBufferIndex + 1) % s_inputBufferCount;
+    Ds4Input::Report report;
+    Ds4Input::ReadReport(rawDataArray, rawDataBytesEach * rawDataCount, ReadGkosKeyboardKeys(), &report);
 
-    Ds4Frame & ds4Frame = s_ds4FrameBuffer[s_inputBufferIndex];
-    memcpy(&ds4Frame, rawDataArray, rawDataBytesEach * rawDataCount);
-    
-    unsigned povValue = rawDataArray[DS4_BYTE_FACE_AND_POV] & 0x0F;
-    unsigned gkosChord = 0x0;
-    /*
-    if (rawDataArray[DS4_BYTE_L_R_MISC_DIGITAL] & (1 << 0)) // L1
-        gkosChord |= GKOS_KEY_FLAG_1;
-    if ((povValue >= 1 && povValue <= 3) || rawDataArray[DS4_BYTE_L2_ANALOG] >= 0x1F) // POV East OR L2
-        gkosChord |= GKOS_KEY_FLAG_2;
-    if (povValue >= 3 && povValue <= 5) // POV South
-        gkosChord |= GKOS_KEY_FLAG_3;
-    if (rawDataArray[DS4_BYTE_L_R_MISC_DIGITAL] & (1 << 1)) // R1
-        gkosChord |= GKOS_KEY_FLAG_4;
-    if ((rawDataArray[DS4_BYTE_FACE_AND_POV] & (1 << 4)) || rawDataArray[DS4_BYTE_R2_ANALOG] >= 0x1F) // Square OR R2
-        gkosChord |= GKOS_KEY_FLAG_5;
-    if (rawDataArray[DS4_BYTE_FACE_AND_POV] & (1 << 5)) // X
-        gkosChord |= GKOS_KEY_FLAG_6;
-    /*/
-    //if (rawDataArray[DS4_BYTE_L_R_MISC_DIGITAL] & (1 << 0)) // L1
-        //gkosChord |= GKOS_KEY_FLAG_3;
-    if ((povValue >= 1 && povValue <= 3) || rawDataArray[DS4_BYTE_L2_ANALOG] >= 0x1F) // POV East OR L2
-        gkosChord |= GKOS_KEY_FLAG_1;
-    if (povValue >= 3 && povValue <= 5) // POV South
-        gkosChord |= GKOS_KEY_FLAG_2;
-    //if (rawDataArray[DS4_BYTE_L_R_MISC_DIGITAL] & (1 << 1)) // R1
-        //gkosChord |= GKOS_KEY_FLAG_6;
-    if ((rawDataArray[DS4_BYTE_FACE_AND_POV] & (1 << 4)) || rawDataArray[DS4_BYTE_R2_ANALOG] >= 0x1F) // Square OR R2
-        gkosChord |= GKOS_KEY_FLAG_4;
-    if (rawDataArray[DS4_BYTE_FACE_AND_POV] & (1 << 5)) // X
-        gkosChord |= GKOS_KEY_FLAG_5;
-    //*/
-
-    // Combine with keyboard-based gkos keys
-    for (unsigned i = 1; i <= 6; ++i) {
-        if (GkosDll::g_IsGkosKeyboardKeyPressed(i))
-            gkosChord |= (1 << (i - 1));
+    if (report.batteryChanged)
+        ShowDs4Battery(Ds4Input::GetBatteryLevel());
+    if (report.pointerReady)
+        SendPointerMotion(report.pointerMotion);
+
+    // Pointing usually ends in a click somewhere else, so what's behind the
+    // caret is no longer what correction and macros think was typed
+    if (report.pointerStarted) {
+        ChordCorrect::Reset();
+        ChordMacros::Reset();
     }
-        
-    s_gkosFrameBuffer[s_inputBufferIndex].chordCode = gkosChord;
-    s_gkosFrameBuffer[s_inputBufferIndex].flags     = 0;
-    
+
+    // Send the key if the chord was just pressed
+    const unsigned gkosChord = report.chordCode;
     if (!gkosChord)
         return;
 
-    bool chordPressed = true;
-    for (unsigned i = 1; i < s_chordMinFrameCount; ++i) {
-        const GkosChordFrame & gkosFrame = GetRelativeGkosChordFrame(i);
-        if (gkosFrame.chordCode != gkosChord) {
-            chordPressed = false;
-            break;
-        }
-    }
+    const GkosChord & gkosKey = gkosKeysAbc[gkosChord];
+    TCHAR buf[64];
+    if (gkosKeysAbc[gkosChord].str)
+        swprintf_s(buf, L"Chord 0x%02X yields Key %s\n", gkosChord, gkosKey.str);
+    else
+        swprintf_s(buf, L"Chord 0x%02X yields Virtual Key %X\n", gkosChord, gkosKey.vkey);
+    OutputDebugString(buf);
+
+    if (s_sessionFile)
+        fprintf(s_sessionFile, "%02X %02X\n", gkosChord, Ds4Input::GetUncertainKeys(gkosChord));
     
-    // Send the key if the chord was just pressed
-    if (chordPressed && GetRelativeGkosChordFrame(s_chordMinFrameCount).chordCode != gkosChord) {
-        const GkosChord & gkosKey = gkosKeysAbc[gkosChord];
-        TCHAR buf[64];
-        if (gkosKeysAbc[gkosChord].str)
-            swprintf_s(buf, L"Chord 0x%02X yields Key %s\n", gkosChord, gkosKey.str);
-        else
-            swprintf_s(buf, L"Chord 0x%02X yields Virtual Key %X\n", gkosChord, gkosKey.vkey);
-        OutputDebugString(buf);
-        
-        INPUT ins[32];
-        UINT  insCount = 0;
-        memset(ins, 0, sizeof(ins));
-        for (unsigned i = 0; i < 32; ++i)
-            ins[i].type = INPUT_KEYBOARD; // Can also use _MOUSE or _HARDWARE
+    ChordMacros::Expansion expansion;
+    if (ChordMacros::CommitChord(gkosChord, &expansion)) {
+        ChordCorrect::Reset();
+        SendMacroExpansion(expansion);
+        return;
+    }
 
-        if (gkosKey.vkey) {
-            ins[0].ki.wVk = gkosKey.vkey;
-        }
-        else if (gkosKey.str) {
-            // Note: This doesn't handle numpad keys
-            SHORT vkey = VkKeyScanEx(gkosKey.str[0], NULL);
-            if (vkey == -1)
-                return;
-                
-            ins[0].ki.wVk = vkey;
-        }
-        else
-            return;
+    if (s_chordCorrectEnabled && SendCorrectedChord(gkosChord))
+        return;
+
+    if (gkosKey.vkey) {
+        SendKeyTaps(&gkosKey.vkey, 1);
+        return;
+    }
+    if (!gkosKey.str)
+        return;
 
-        SendInput(1, ins, sizeof(ins[0]));
-        ins[0].ki.dwFlags = KEYEVENTF_KEYUP;
-        SendInput(1, ins, sizeof(ins[0]));
+    // Multi-letter chords ("th", "the ") type every character
+    WORD     vkeys[16];
+    unsigned vkeyCount = 0;
+    for (const TCHAR * ch = gkosKey.str; *ch && vkeyCount < sizeof(vkeys) / sizeof(vkeys[0]); ++ch) {
+        if (CharToVirtualKey(*ch, &vkeys[vkeyCount]))
+            ++vkeyCount;
     }
+    SendKeyTaps(vkeys, vkeyCount);
 
 }
 
@@ -340,6 +401,26 @@ LRESULT CALLBACK WndProc (
             else if (wParam == 'l') {
                 ListDevices();
             }
+            else if (wParam == 'c') {
+                if (!ChordCorrect::IsReady() && !ChordCorrect::LoadLanguageModel(s_chordCorrectCorpus)) {
+                    OutputDebugString(L"Chord correction needs gkos_corpus.txt\n");
+                    break;
+                }
+                s_chordCorrectEnabled = !s_chordCorrectEnabled;
+                ChordCorrect::Reset();
+                ChordMacros::Reset();
+                OutputDebugString(s_chordCorrectEnabled ? L"Chord correction on\n" : L"Chord correction off\n");
+            }
+            else if (wParam == 'r') {
+                if (s_sessionFile) {
+                    fclose(s_sessionFile);
+                    s_sessionFile = NULL;
+                    OutputDebugString(L"Session recording off\n");
+                }
+                else if (_wfopen_s(&s_sessionFile, s_sessionPath, L"a") == 0 && s_sessionFile) {
+                    OutputDebugString(L"Recording session to gkos_session.txt\n");
+                }
+            }
         } break;
         
         case WM_INPUT: {
@@ -347,11 +428,14 @@ LRESULT CALLBACK WndProc (
             static const UINT s_ds4Product = 0x5C4;
             UINT              bufferSize   = 0;
             
+            // Reused for every report so the input path never allocates
+            static ULONGLONG  s_rawInputBuffer[128];
+
             GetRawInputData((HRAWINPUT)lParam, RID_INPUT, NULL, &bufferSize, sizeof(RAWINPUTHEADER));
-            LPBYTE lpb = new BYTE[bufferSize];
-            memset(lpb, 0, bufferSize);
-            if (lpb == NULL) 
+            if (bufferSize > sizeof(s_rawInputBuffer))
                 break;
+            LPBYTE lpb = (LPBYTE)s_rawInputBuffer;
+            memset(lpb, 0, bufferSize);
 
             GetRawInputData((HRAWINPUT)lParam, RID_INPUT, lpb, &bufferSize, sizeof(RAWINPUTHEADER));
             RAWINPUT* raw = (RAWINPUT*)lpb;
@@ -370,8 +454,6 @@ LRESULT CALLBACK WndProc (
                 break;
                 
             ReadDs4RawInput(raw->data.hid.dwCount, raw->data.hid.dwSizeHid, raw->data.hid.bRawData);
-
-            delete[] lpb; 
         } return 0;
     }
 
@@ -399,6 +481,16 @@ bool LoadGkosDll () {
         return false;
     }
 
+    GkosDll::g_GetGkosKeyboardKeyState = (GkosDll::GkosKeyState)(
+        GetProcAddress(
+            GkosDll::g_dllHandle,
+            "GetGkosKeyboardKeyState"
+        )
+    );
+    assert(GkosDll::g_GetGkosKeyboardKeyState);
+    if (!GkosDll::g_GetGkosKeyboardKeyState)
+        return false;
+
     return true;
 
 }
@@ -421,9 +513,6 @@ int WINAPI wWinMain (
     int       command_show
 ) {
 
-    memset(s_ds4FrameBuffer, 0, sizeof(s_ds4FrameBuffer));
-    memset(s_gkosFrameBuffer, 0, sizeof(s_gkosFrameBuffer));
-
     g_mainWindowHandle = instance;
 
     WNDCLASSEX windowClass    = {0};
@@ -450,6 +539,7 @@ int WINAPI wWinMain (
 
     if (!hwnd)
         return 1;
+    g_mainWindow = hwnd;
 
     ShowWindow(hwnd, command_show);
     
@@ -468,21 +558,49 @@ int WINAPI wWinMain (
     if (!LoadGkosDll())
         return 1;
 
+    Ds4Input::Reset();
+    ChordCorrect::Init(gkosKeysAbc);
+    ChordMacros::Init(gkosKeysAbc);
+    if (ChordMacros::Load(s_macroSource, s_macroCompiled))
+        OutputDebugString(L"Loaded macros\n");
+
+    ResetPowerStats();
+
     MSG msg = {0};
     while (msg.message != WM_QUIT)
     {
-        if (PeekMessage(&msg, 0, 0, 0, PM_REMOVE)) {
+        // Sleep until there's work instead of spinning.  Once the chord has
+        // sat unchanged for a while, stop waking on every DS4 report: leave
+        // raw input queued and drain it in one batch per poll.  Reports are
+        // still processed in order, so chords are detected the same way.  A
+        // key change only shows up inside a report, so the first one after
+        // idling is seen up to one poll late, but it puts us straight back
+        // in active mode.  The poll is shorter than the chord hold time, so
+        // the report that commits the chord is read as it arrives; gkospower
+        // checks this.
+        const bool idle = Ds4Input::IsIdle();
+        MsgWaitForMultipleObjectsEx(
+            0,
+            NULL,
+            idle ? Ds4Input::s_idlePollDelay : INFINITE,
+            idle ? (QS_ALLINPUT & ~QS_RAWINPUT) : QS_ALLINPUT,
+            MWMO_INPUTAVAILABLE
+        );
+        ++s_powerStats.wakeupCount;
+
+        while (PeekMessage(&msg, 0, 0, 0, PM_REMOVE)) {
+            if (msg.message == WM_QUIT)
+                break;
             TranslateMessage(&msg);
             DispatchMessage(&msg);
         }
-        else {
-            // Update and Draw
-            //timer.Tick();
-            //demo->Update(timer.DeltaTime());
-            //demo->Render();
-        }
+
+        UpdatePowerStats();
     }
 
+    if (s_sessionFile)
+        fclose(s_sessionFile);
+    ChordMacros::Unload();
     UnloadGkosDll();
 
     return static_cast<int>(msg.wParam);
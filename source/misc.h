@@ -1,3 +1,5 @@
+#pragma once
+
 #define WIN32_LEAN_AND_MEAN
 #define NOMINMAX
 #include <Windows.h>
@@ -23,17 +25,17 @@ enum EDs4Byte {
     DS4_BYTE_BYTE_10,
     DS4_BYTE_BYTE_11,
     DS4_BYTE_BATTERY_LEVEL,
-    DS4_BYTE_13,
-    DS4_BYTE_14,
-    DS4_BYTE_15,
+    DS4_BYTE_GYRO_X,         // Motion: six little-endian int16s, low byte first
+    DS4_BYTE_14,             // Gyro X = pitch, Y = yaw, Z = roll (~16 per deg/s)
+    DS4_BYTE_GYRO_Y,
     DS4_BYTE_16,
-    DS4_BYTE_17,
+    DS4_BYTE_GYRO_Z,
     DS4_BYTE_18,
-    DS4_BYTE_19,
+    DS4_BYTE_ACCEL_X,        // Accel ~8192 per g; Y is up when the pad lies flat
     DS4_BYTE_20,
-    DS4_BYTE_21,
+    DS4_BYTE_ACCEL_Y,
     DS4_BYTE_22,
-    DS4_BYTE_23,
+    DS4_BYTE_ACCEL_Z,
     DS4_BYTE_24,
     DS4_BYTE_25,
     DS4_BYTE_26,
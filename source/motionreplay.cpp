@@ -0,0 +1,170 @@
+// gkosmotion: replays recorded DS4 motion through Ds4Motion.
+//
+// A trace file holds one or more cases.  Each starts with
+//
+//     case <name> <dx> <dy> <wheel> <tolerance>
+//
+// followed by one report per line: the L/R digital byte, then gyro X/Y/Z and
+// accel X/Y/Z as signed decimals.  ';' starts a comment.  Every case starts
+// from Ds4Motion::Reset(), and the pointer motion it produces is summed and
+// compared with the expected totals.  Each total must land within the
+// tolerance.
+//
+// Usage: gkosmotion <traces.txt>
+
+#include "ds4motion.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+struct TraceReport {
+    BYTE  buttons;
+    short gyro[3];
+    short accel[3];
+};
+
+struct TraceCase {
+    char                     name[64];
+    int                      expected[3]; // dx, dy, wheel
+    int                      tolerance;
+    std::vector<TraceReport> reports;
+};
+
+//=============================================================================
+static bool ReadTraces (const char * path, std::vector<TraceCase> * cases) {
+
+    FILE * file = NULL;
+    if (fopen_s(&file, path, "r") != 0 || !file)
+        return false;
+
+    char     line[256];
+    unsigned lineNum = 0;
+    bool     valid   = true;
+    while (valid && fgets(line, sizeof(line), file)) {
+        ++lineNum;
+        char * comment = strchr(line, ';');
+        if (comment)
+            *comment = 0;
+
+        TraceCase traceCase;
+        if (sscanf_s(line, " case %63s %d %d %d %d", traceCase.name, unsigned(sizeof(traceCase.name)),
+                &traceCase.expected[0], &traceCase.expected[1], &traceCase.expected[2], &traceCase.tolerance) == 5) {
+            cases->push_back(traceCase);
+            continue;
+        }
+
+        int fields[7];
+        const int fieldCount = sscanf_s(line, "%d %d %d %d %d %d %d",
+            &fields[0], &fields[1], &fields[2], &fields[3], &fields[4], &fields[5], &fields[6]);
+        if (fieldCount == EOF)
+            continue; // Blank or comment
+        if (fieldCount != 7 || cases->empty()) {
+            fprintf(stderr, "%s(%u): bad report\n", path, lineNum);
+            valid = false;
+            break;
+        }
+
+        TraceReport report;
+        report.buttons = BYTE(fields[0]);
+        for (unsigned i = 0; i < 3; ++i) {
+            report.gyro[i]  = short(fields[1 + i]);
+            report.accel[i] = short(fields[4 + i]);
+        }
+        cases->back().reports.push_back(report);
+    }
+    fclose(file);
+
+    return valid && !cases->empty();
+
+}
+
+//=============================================================================
+static void WriteInt16 (BYTE * rawDataArray, unsigned byteIndex, short value) {
+    rawDataArray[byteIndex]     = BYTE(value & 0xFF);
+    rawDataArray[byteIndex + 1] = BYTE((value >> 8) & 0xFF);
+}
+
+//=============================================================================
+static void BuildReport (const TraceReport & report, BYTE * rawDataArray) {
+    rawDataArray[DS4_BYTE_L_R_MISC_DIGITAL] = report.buttons;
+    WriteInt16(rawDataArray, DS4_BYTE_GYRO_X,  report.gyro[0]);
+    WriteInt16(rawDataArray, DS4_BYTE_GYRO_Y,  report.gyro[1]);
+    WriteInt16(rawDataArray, DS4_BYTE_GYRO_Z,  report.gyro[2]);
+    WriteInt16(rawDataArray, DS4_BYTE_ACCEL_X, report.accel[0]);
+    WriteInt16(rawDataArray, DS4_BYTE_ACCEL_Y, report.accel[1]);
+    WriteInt16(rawDataArray, DS4_BYTE_ACCEL_Z, report.accel[2]);
+}
+
+//=============================================================================
+int main (int argc, char ** argv) {
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: gkosmotion <traces.txt>\n");
+        return 1;
+    }
+
+    std::vector<TraceCase> cases;
+    if (!ReadTraces(argv[1], &cases)) {
+        fprintf(stderr, "Couldn't read any trace cases from %s\n", argv[1]);
+        return 1;
+    }
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+
+    unsigned  failCount   = 0;
+    unsigned  reportCount = 0;
+    ULONGLONG totalTicks  = 0;
+    for (size_t c = 0; c < cases.size(); ++c) {
+        const TraceCase & traceCase = cases[c];
+
+        // Build every report up front so only Update() is timed
+        std::vector<Ds4Frame> frames(traceCase.reports.size());
+        for (size_t i = 0; i < frames.size(); ++i)
+            BuildReport(traceCase.reports[i], frames[i].rawData);
+
+        int           total[3] = { 0, 0, 0 };
+        LARGE_INTEGER startTime, endTime;
+        Ds4Motion::Reset();
+        QueryPerformanceCounter(&startTime);
+        for (size_t i = 0; i < frames.size(); ++i) {
+            Ds4Motion::PointerMotion motion;
+            if (Ds4Motion::Update(frames[i].rawData, &motion)) {
+                total[0] += motion.dx;
+                total[1] += motion.dy;
+                total[2] += motion.wheel;
+            }
+        }
+        QueryPerformanceCounter(&endTime);
+        totalTicks  += ULONGLONG(endTime.QuadPart - startTime.QuadPart);
+        reportCount += unsigned(frames.size());
+
+        bool passed = true;
+        for (unsigned i = 0; i < 3; ++i) {
+            if (abs(total[i] - traceCase.expected[i]) > traceCase.tolerance)
+                passed = false;
+        }
+        if (!passed)
+            ++failCount;
+
+        printf(
+            "%-26s dx %5d (%5d)  dy %5d (%5d)  wheel %4d (%4d)  +-%-3d %s\n",
+            traceCase.name,
+            total[0], traceCase.expected[0],
+            total[1], traceCase.expected[1],
+            total[2], traceCase.expected[2],
+            traceCase.tolerance,
+            passed ? "ok" : "FAILED"
+        );
+    }
+
+    printf(
+        "%u of %u cases passed, %.0f ns per report\n",
+        unsigned(cases.size()) - failCount,
+        unsigned(cases.size()),
+        totalTicks * 1.0e9 / double(frequency.QuadPart) / reportCount
+    );
+
+    return failCount ? 1 : 0;
+
+}
@@ -0,0 +1,257 @@
+// gkospower: replays DS4 report streams through Ds4Input and the app's
+// message loop to measure what a session costs.
+//
+// Three synthetic sessions are generated, one report every 4 ms:
+//
+//     idle   The pad rests on a desk.  Only sensor noise changes.
+//     light  A burst of 10 chords every 20 s, idle in between.
+//     heavy  Four chords a second without a break, plus a 2 s air-pointer
+//            swipe every 30 s.
+//
+// Chords mix pad buttons and keyboard gkos keys, and the first key of each
+// lands a couple of reports before the rest.  The loop is simulated the way
+// wWinMain runs it: while active, each report wakes it; while idle, it wakes
+// once per poll and drains everything queued.  For each session this prints
+// wakeups, reports, fast-path hits and the CPU time spent in ReadReport, all
+// per minute, so the numbers line up with the app's own "Power:" log line.
+// Wakeup overhead itself isn't in the CPU time; count it from the wakeups.
+//
+// A session fails if any chord isn't committed exactly once, if a chord
+// reaches the app more than one poll late, or if it wakes more than the
+// session allows.
+//
+// Usage: gkospower [minutes]
+
+#include "ds4input.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+static const unsigned s_timingRunCount  = 3;   // Keep each session's fastest run, so preemption doesn't count
+static const unsigned s_defaultMinutes  = 10;
+static const unsigned s_reportsPerMin   = MS_PER_SECOND * 60 / Ds4Input::s_frameDelay;
+
+// Synthetic typing
+static const unsigned s_chordHoldFrames = 120 / Ds4Input::s_frameDelay;
+static const unsigned s_chordGapFrames  = 130 / Ds4Input::s_frameDelay;
+static const unsigned s_chordLeadFrames = 2; // Frames the first key lands ahead of the rest
+static const int      s_sensorNoise     = 6; // Raw units either way
+static const int      s_accelOneG       = 8192;
+
+// Pad button bits for each gkos key, as DecodeDs4Chord reads them.  Keys 3
+// and 6 only come from the keyboard.
+static const BYTE     s_povSouth        = 4;
+static const BYTE     s_povNone         = 8;
+static const BYTE     s_squareButton    = 1 << 4;
+static const BYTE     s_crossButton     = 1 << 5;
+static const BYTE     s_pointerButton   = 1 << 0; // L1
+
+struct SessionFrame {
+    Ds4Frame frame;
+    unsigned keyboardKeys;
+};
+
+struct Session {
+    const char *              name;
+    unsigned                  maxWakeupsMin; // 0 = unchecked
+    unsigned                  chordCount;
+    std::vector<SessionFrame> frames;
+};
+
+struct SessionResult {
+    unsigned  wakeupCount;
+    unsigned  commitCount;
+    unsigned  maxCommitDelay; // ms from the committing report to when the loop read it
+    Ds4Input::Stats stats;
+    ULONGLONG readTicks;
+};
+
+//=============================================================================
+static void WriteInt16 (BYTE * rawDataArray, unsigned byteIndex, int value) {
+    rawDataArray[byteIndex]     = BYTE(value & 0xFF);
+    rawDataArray[byteIndex + 1] = BYTE((value >> 8) & 0xFF);
+}
+
+//=============================================================================
+// Same stream on every run
+static int Noise (unsigned * seed) {
+    *seed = *seed * 1103515245 + 12345;
+    return int((*seed >> 16) % (s_sensorNoise * 2 + 1)) - s_sensorNoise;
+}
+
+//=============================================================================
+static void AddFrames (
+    Session *  session,
+    unsigned   frameCount,
+    unsigned   chordCode,
+    int        yawRate,
+    unsigned * seed
+) {
+
+    for (unsigned i = 0; i < frameCount; ++i) {
+        SessionFrame sessionFrame;
+        memset(&sessionFrame, 0, sizeof(sessionFrame));
+        BYTE * rawData = sessionFrame.frame.rawData;
+
+        rawData[DS4_BYTE_FACE_AND_POV]  = (chordCode & GKOS_KEY_FLAG_2) ? s_povSouth : s_povNone;
+        if (chordCode & GKOS_KEY_FLAG_4)
+            rawData[DS4_BYTE_FACE_AND_POV] |= s_squareButton;
+        if (chordCode & GKOS_KEY_FLAG_5)
+            rawData[DS4_BYTE_FACE_AND_POV] |= s_crossButton;
+        rawData[DS4_BYTE_L2_ANALOG]     = (chordCode & GKOS_KEY_FLAG_1) ? 0xFF : 0;
+        rawData[DS4_BYTE_BATTERY_LEVEL] = 0x08;
+        sessionFrame.keyboardKeys       = chordCode & (GKOS_KEY_FLAG_3 | GKOS_KEY_FLAG_6);
+
+        if (yawRate)
+            rawData[DS4_BYTE_L_R_MISC_DIGITAL] = s_pointerButton;
+        WriteInt16(rawData, DS4_BYTE_GYRO_X,  Noise(seed));
+        WriteInt16(rawData, DS4_BYTE_GYRO_Y,  Noise(seed) + yawRate);
+        WriteInt16(rawData, DS4_BYTE_GYRO_Z,  Noise(seed));
+        WriteInt16(rawData, DS4_BYTE_ACCEL_X, Noise(seed));
+        WriteInt16(rawData, DS4_BYTE_ACCEL_Y, Noise(seed) + s_accelOneG);
+        WriteInt16(rawData, DS4_BYTE_ACCEL_Z, Noise(seed));
+
+        session->frames.push_back(sessionFrame);
+    }
+
+}
+
+//=============================================================================
+static void AddChord (Session * session, unsigned * seed) {
+
+    // Walk all 63 chords, in an order that changes most keys between them
+    const unsigned chordCode = (session->chordCount * 37) % 63 + 1;
+    const unsigned firstKey  = chordCode & (0 - chordCode);
+    ++session->chordCount;
+
+    AddFrames(session, s_chordLeadFrames, firstKey, 0, seed);
+    AddFrames(session, s_chordHoldFrames - s_chordLeadFrames, chordCode, 0, seed);
+    AddFrames(session, s_chordGapFrames, 0, 0, seed);
+
+}
+
+//=============================================================================
+static void BuildSessions (unsigned minutes, std::vector<Session> * sessions) {
+
+    const unsigned frameCount = minutes * s_reportsPerMin;
+    unsigned       seed       = 1;
+    sessions->resize(3);
+
+    Session & idle = (*sessions)[0];
+    idle.name          = "idle";
+    idle.maxWakeupsMin = 1500; // One per poll once settled, ~1300
+    AddFrames(&idle, frameCount, 0, 0, &seed);
+
+    Session & light = (*sessions)[1];
+    light.name          = "light";
+    light.maxWakeupsMin = 7500; // ~6400
+    while (light.frames.size() < frameCount) {
+        const size_t burstStart = light.frames.size();
+        for (unsigned i = 0; i < 10; ++i)
+            AddChord(&light, &seed);
+        const size_t burstFrames = light.frames.size() - burstStart;
+        AddFrames(&light, unsigned(20 * MS_PER_SECOND / Ds4Input::s_frameDelay - burstFrames), 0, 0, &seed);
+    }
+
+    Session & heavy = (*sessions)[2];
+    heavy.name          = "heavy";
+    heavy.maxWakeupsMin = 0;
+    while (heavy.frames.size() < frameCount) {
+        for (unsigned i = 0; i < 4 * 28; ++i)
+            AddChord(&heavy, &seed);
+        AddFrames(&heavy, 2 * MS_PER_SECOND / Ds4Input::s_frameDelay, 0, 800, &seed);
+    }
+
+}
+
+//=============================================================================
+static void Replay (const Session & session, SessionResult * result) {
+
+    memset(result, 0, sizeof(*result));
+    Ds4Input::Reset();
+
+    // Reports arrive every s_frameDelay ms; the loop reads all that have
+    // arrived by the time it wakes
+    const unsigned frameCount = unsigned(session.frames.size());
+    unsigned       nextFrame  = 0;
+    unsigned       now        = 0;
+    while (nextFrame < frameCount) {
+        if (Ds4Input::IsIdle())
+            now += Ds4Input::s_idlePollDelay;
+        else
+            now = std::max(now, nextFrame * Ds4Input::s_frameDelay);
+        ++result->wakeupCount;
+
+        LARGE_INTEGER startTime, endTime;
+        QueryPerformanceCounter(&startTime);
+        for (; nextFrame < frameCount && nextFrame * Ds4Input::s_frameDelay <= now; ++nextFrame) {
+            const SessionFrame & sessionFrame = session.frames[nextFrame];
+            Ds4Input::Report     report;
+            Ds4Input::ReadReport(sessionFrame.frame.rawData, sizeof(sessionFrame.frame), sessionFrame.keyboardKeys, &report);
+            if (report.chordCode) {
+                ++result->commitCount;
+                result->maxCommitDelay = std::max(result->maxCommitDelay, now - nextFrame * Ds4Input::s_frameDelay);
+            }
+        }
+        QueryPerformanceCounter(&endTime);
+        result->readTicks += ULONGLONG(endTime.QuadPart - startTime.QuadPart);
+    }
+    result->stats = Ds4Input::GetStats();
+
+}
+
+//=============================================================================
+int main (int argc, char ** argv) {
+
+    const unsigned minutes = argc > 1 ? unsigned(atoi(argv[1])) : s_defaultMinutes;
+    if (!minutes) {
+        fprintf(stderr, "Usage: gkospower [minutes]\n");
+        return 1;
+    }
+
+    std::vector<Session> sessions;
+    BuildSessions(minutes, &sessions);
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+
+    unsigned failCount = 0;
+    printf("session  wakeups/min  reports/min  fast path/min  CPU us/min  chords  max delay\n");
+    for (size_t s = 0; s < sessions.size(); ++s) {
+        const Session & session = sessions[s];
+
+        SessionResult result;
+        ULONGLONG     readTicks = 0;
+        for (unsigned run = 0; run < s_timingRunCount; ++run) {
+            Replay(session, &result);
+            readTicks = run ? std::min(readTicks, result.readTicks) : result.readTicks;
+        }
+
+        const double   sessionMin = double(session.frames.size()) / s_reportsPerMin;
+        const unsigned wakeupsMin = unsigned(result.wakeupCount / sessionMin);
+        const double   cpuUsMin   = readTicks * 1.0e6 / double(frequency.QuadPart) / sessionMin;
+
+        bool passed = result.commitCount == session.chordCount && result.maxCommitDelay <= Ds4Input::s_idlePollDelay;
+        if (session.maxWakeupsMin && wakeupsMin > session.maxWakeupsMin)
+            passed = false;
+        if (!passed)
+            ++failCount;
+
+        printf(
+            "%-7s  %11u  %11u  %13u  %10.0f  %5u/%-5u  %6u ms  %s\n",
+            session.name,
+            wakeupsMin,
+            unsigned(result.stats.reportCount / sessionMin),
+            unsigned(result.stats.fastPathCount / sessionMin),
+            cpuUsMin,
+            result.commitCount,
+            session.chordCount,
+            result.maxCommitDelay,
+            passed ? "ok" : "FAILED"
+        );
+    }
+
+    return failCount ? 1 : 0;
+
+}